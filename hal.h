@@ -0,0 +1,41 @@
+#ifndef HAL_H
+#define HAL_H
+
+/*Purpose: Hardware access for main.c and servo.c, chosen when they are compiled.
+            Built for the board (cram.BAT, cram2.BAT) registers are read and written where they sit in the
+            memory map, so REG_READ(R_SCSR) is the same single load as before.
+            Built with -DHOST (see the Makefile) the same names go through host/target.h to the simulator,
+            which charges the E-clock for each access and models the SCI, timer, Port A and the A/D converter.
+            FRAME_VECTOR and INTERRUPT_FRAME use interruptFrame, which only main.c defines.
+*/
+
+#include "hc11regs.h"
+
+#ifdef HOST
+#include "host/target.h"    // Host build against the simulated 68HC11, see host/harness.c
+#else
+#define PTR(addr) ((unsigned char *)(addr))                         // Target address to pointer
+#define ADDR(ptr) ((unsigned int)(ptr))                             // Pointer to target address
+#define REG_READ(addr) (*(volatile unsigned char *)(addr))
+#define REG_WRITE(addr, value) (*(volatile unsigned char *)(addr) = (value))
+#define REG_READ16(addr) (*(volatile unsigned int *)(addr))          // Both bytes in one access (TCNT)
+#define REG_WRITE16(addr, value) (*(volatile unsigned int *)(addr) = (value))
+#define WORD unsigned int                                           // 16 bits, for LDD/STD copies
+#define CALL(ptr) ((unsigned char *(*)()) (ptr))()
+#define INTERRUPT @interrupt
+#define ENABLE_INTERRUPTS() _asm("cli\n")
+#define DISABLE_INTERRUPTS() _asm("sei\n")
+#define SET_VECTOR(vector, handler) (*PTR(vector) = 0x7E, *(void (**)())PTR((vector) + 1) = (handler)) // JMP handler
+// As SET_VECTOR, but through stub (7 bytes of RAM), which saves where the registers were stacked first:
+// TSX, STX interruptFrame, JMP handler
+#define FRAME_VECTOR(vector, stub, handler) ((stub)[0] = 0x30, (stub)[1] = 0xFF, \
+        *(unsigned char * volatile **)((stub) + 2) = &interruptFrame, \
+        (stub)[4] = 0x7E, *(void (**)())((stub) + 5) = (handler), SET_VECTOR(vector, (void (*)())(stub)))
+#define INTERRUPT_FRAME() interruptFrame                            // Stacked CCR, B, A, X, Y, PC, see FRAME_VECTOR
+#define IDLE()                                                      // Nothing to do while spinning on the target
+// First byte after the monitor's data, __memory (the end of .bss) from the link file, for the startup code
+extern unsigned char _memory;
+#define MONITOR_END ADDR(&_memory)
+#endif
+
+#endif
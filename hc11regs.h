@@ -0,0 +1,35 @@
+#ifndef HC11REGS_H
+#define HC11REGS_H
+
+/*Purpose: 68HC11 register block, mapped at 0x0000 on the board.
+            Shared by main.c and servo.c (through hal.h) and by the simulator's peripheral model in host/.
+*/
+
+#define R_PORTA  0x00       // Port A data
+#define R_DDRA   0x01       // Port A data direction, Input=0/Output=1
+#define R_PORTG  0x02
+#define R_DDRG   0x03
+#define R_CFORC  0x0B
+#define R_OC1M   0x0C       // Pins OC1 drives
+#define R_OC1D   0x0D       // Levels OC1 drives them to
+#define R_TCNT   0x0E       // Free running counter (16 bit)
+#define R_TOC1   0x16       // Output compares (16 bit)
+#define R_TOC2   0x18
+#define R_TOC3   0x1A
+#define R_TOC4   0x1C
+#define R_TOC5   0x1E
+#define R_TCTL1  0x20
+#define R_TMSK1  0x22       // OCxI
+#define R_TFLG1  0x23       // OCxF
+#define R_TMSK2  0x24       // TOI, RTII
+#define R_TFLG2  0x25       // TOF, RTIF
+#define R_PACTL  0x26       // RTR rate bits
+#define R_BAUD   0x2B
+#define R_SCCR1  0x2C
+#define R_SCCR2  0x2D       // TIE, TCIE, RIE
+#define R_SCSR   0x2E       // TDRE, TC, RDRF, IDLE, OR
+#define R_SCDR   0x2F
+#define R_ADCTL  0x30
+#define R_ADR1   0x31
+
+#endif
@@ -0,0 +1,209 @@
+/*Purpose: hc11sim - runs the monitor (main.c built with -DHOST) against the simulated 68HC11.
+            The script is typed into the SCI a line at a time, output from the SCI goes to stdout,
+            and the E-clock cycles taken are reported on stderr.
+            With -i the monitor carries on reading from stdin once the script is used up, a line at a time from a
+            pipe or a key at a time from a terminal (echo off, the monitor echoes as it does on the board).
+            ^D at the terminal stops it.
+            With -p the SCI is a pseudo terminal instead, whose name is printed, for lbsend and rp to talk to
+            as if it were the board's serial port. ^C stops it.
+
+Usage: hc11sim [-b baud] [-s] [-r] [-t] [-q] [-i] [-p] [-S] [-a adc] [-c cycles] [-l file.s19]... [script]
+            -b  SCI baud rate (default 9600)
+            -s  After the first line, stream the script back to back instead of waiting for the monitor before each line
+            -r  Send the script as it is, without dropping carriage returns (binary data, see lbsend)
+            -t  Report the cycles taken by each line of the script
+            -q  Do not copy SCI output to stdout
+            -i  Interactive, take input from stdin after the script (which then has to be a file)
+            -p  Take input from and send output to a pseudo terminal after the script
+            -S  Start servo.c's driver before the monitor, as loading it with lf and go would
+            -a  Value returned by the A/D converter (default 0x6F, the pot midpoint)
+            -c  Stop after this many E-clock cycles
+            -l  Load an S-record file into memory before starting
+*/
+
+#define _GNU_SOURCE     // posix_openpt() and friends
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <termios.h>
+#include <unistd.h>
+#include "hc11.h"
+#include "srec.h"
+
+void monitorMain(), servoMain();
+
+static struct termios terminal;
+static int terminalSaved;
+
+static void restoreTerminal(void)
+{
+    if (terminalSaved){
+        tcsetattr(STDIN_FILENO, TCSANOW, &terminal);
+    }
+}
+
+static void interrupted(int signal)
+{
+    restoreTerminal();
+    _exit(1);
+}
+
+static void rawTerminal(void)
+// Key at a time without the terminal's own echo, ^C still stops the simulator
+{
+    struct termios raw;
+
+    if (tcgetattr(STDIN_FILENO, &terminal) < 0){
+        return;
+    }
+    terminalSaved = 1;
+    atexit(restoreTerminal);
+    signal(SIGINT, interrupted);
+    raw = terminal;
+    raw.c_lflag &= ~(ICANON | ECHO);
+    raw.c_cc[VMIN] = 1;
+    raw.c_cc[VTIME] = 0;
+    tcsetattr(STDIN_FILENO, TCSANOW, &raw);
+}
+
+static void loadRecord(unsigned long addr, const unsigned char *data, int length, void *context)
+{
+    int i;
+
+    for(i = 0; i < length; i++){
+        hc11Memory[(addr + i) & 0xFFFF] = data[i];
+    }
+}
+
+static unsigned char *readScript(FILE *file, int raw, unsigned long *length)
+// Reads the whole script, dropping carriage returns unless raw
+{
+    unsigned char *data = NULL;
+    unsigned long size = 0;
+    int c;
+
+    *length = 0;
+    while((c = getc(file)) != EOF){
+        if (c == '\r' && !raw){
+            continue;
+        }
+        if (*length == size){
+            size = size ? size * 2 : 4096;
+            if ((data = realloc(data, size)) == NULL){
+                perror("hc11sim");
+                exit(2);
+            }
+        }
+        data[(*length)++] = c;
+    }
+    return data;
+}
+
+static int openPort(void)
+/* Purpose: Makes the pseudo terminal the SCI talks to with -p and prints the name to open at the other end.
+            The slave end is held open in raw mode, so the bytes pass through as they are and a client
+            closing it does not end the simulation.
+Version: 1.0
+*/{
+    struct termios raw;
+    char *name;
+    int master, slave;
+
+    if ((master = posix_openpt(O_RDWR | O_NOCTTY)) < 0 || grantpt(master) < 0 || unlockpt(master) < 0 ||
+        (name = ptsname(master)) == NULL || (slave = open(name, O_RDWR | O_NOCTTY)) < 0 || tcgetattr(slave, &raw) < 0){
+        perror("hc11sim");
+        exit(2);
+    }
+    cfmakeraw(&raw);
+    tcsetattr(slave, TCSANOW, &raw);
+    fprintf(stderr, "[hc11sim] SCI on %s\n", name);
+    return master;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "Usage: hc11sim [-b baud] [-s] [-r] [-t] [-q] [-i] [-p] [-S] [-a adc] [-c cycles] [-l file.s19]... [script]\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    SciConfig config = {9600, 0, 1, 0, SCI_SCRIPT, -1};
+    static const char *reasons[] = {"returned", "end of input", "cycle limit", "STOP", "no interrupt handler"};
+    const char *loads[16];
+    int loadCount = 0, raw = 0, servo = 0, option, reason, i;
+    unsigned char adc = 0x6F;
+    unsigned char *script;
+    unsigned long length;
+    FILE *file = stdin;
+
+    while((option = getopt(argc, argv, "b:srtqipSa:c:l:")) != -1){
+        switch (option) {
+            case 'b': config.baud = strtoul(optarg, NULL, 0); break;
+            case 's': config.stream = 1; break;
+            case 'r': raw = 1; break;
+            case 't': config.timing = 1; break;
+            case 'q': config.echo = 0; break;
+            case 'i': config.input = isatty(STDIN_FILENO) ? SCI_KEYS : SCI_LINES; break;
+            case 'p': config.input = SCI_PORT; break;
+            case 'S': servo = 1; break;
+            case 'a': adc = strtoul(optarg, NULL, 0); break;
+            case 'c': hc11CycleLimit = strtoull(optarg, NULL, 0); break;
+            case 'l':
+                if (loadCount == 16){
+                    usage();
+                }
+                loads[loadCount++] = optarg;
+                break;
+            default: usage();
+        }
+    }
+    if (optind + 1 < argc || config.baud == 0){
+        usage();
+    }
+    if (config.input == SCI_PORT){
+        config.port = openPort();
+    }
+    if (config.input != SCI_SCRIPT && (optind == argc || strcmp(argv[optind], "-") == 0)){
+        file = NULL;    // stdin is read as the monitor asks for it
+    }else if (optind < argc && strcmp(argv[optind], "-") != 0 && (file = fopen(argv[optind], "rb")) == NULL){
+        perror(argv[optind]);
+        return 2;
+    }
+    script = file ? readScript(file, raw, &length) : NULL;
+    if (file == NULL){
+        length = 0;
+    }
+    if (config.input == SCI_KEYS){
+        rawTerminal();
+    }
+
+    hc11Reset();
+    for(i = 0; i < loadCount; i++){
+        if (srecRead(loads[i], loadRecord, NULL, NULL) < 0){
+            return 2;
+        }
+    }
+    sciConfigure(&config);
+    sciInput(script, length);
+    adcInput(adc);
+
+    if ((reason = setjmp(hc11Exit)) == 0){
+        if (servo){
+            servoMain();
+        }
+        monitorMain();
+    }
+    fflush(stdout);
+    if (setjmp(hc11Exit) == 0){
+        sciDrain();
+    }
+    fflush(stdout);
+
+    fprintf(stderr, "\n[hc11sim] stopped: %s\n", reasons[reason]);
+    sciReport();
+    free(script);
+    return reason == HC11_STOP_INPUT || reason == HC11_STOP_CYCLES ? 0 : 1;
+}
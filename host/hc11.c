@@ -0,0 +1,839 @@
+/*Purpose: 68HC11 instruction set core for the host simulator.
+            Executes the full instruction set (page 0 and the 0x18, 0x1A and 0xCD prefix pages)
+            and charges each instruction its data sheet E-clock cycle count.
+            Interrupts are taken through the ROM vectors into the RAM pseudo vectors, as on the board.
+            A pseudo vector may also be bound to a native (host compiled) handler with hc11SetNative().
+*/
+
+#include <setjmp.h>
+#include <stdio.h>
+#include "hc11.h"
+
+#define NATIVES 24
+#define INTERRUPT_CYCLES 12
+
+unsigned char hc11Memory[0x10000];
+Hc11Cpu hc11Cpu;
+unsigned long long hc11Cycles;
+unsigned long long hc11CycleLimit;
+unsigned int hc11InterruptFrame;    // Address of the stacked CCR for the running native interrupt handler
+jmp_buf hc11Exit;
+
+static struct{
+    unsigned int addr;
+    void (*handler)(void);
+}natives[NATIVES];
+
+static int running;         // Core is executing target code
+static int inInterrupt;     // A native interrupt handler is active
+static int waiting;         // WAI executed, registers already stacked
+
+// Cycle counts, 0 = illegal opcode
+static const unsigned char page0[256] = {
+/*        0   1   2   3   4   5   6   7   8   9   A   B   C   D   E   F */
+/* 0 */   0,  2, 41, 41,  3,  3,  2,  2,  3,  3,  2,  2,  2,  2,  2,  2,
+/* 1 */   2,  2,  6,  6,  6,  6,  2,  2,  0,  2,  0,  2,  7,  7,  7,  7,
+/* 2 */   3,  3,  3,  3,  3,  3,  3,  3,  3,  3,  3,  3,  3,  3,  3,  3,
+/* 3 */   3,  3,  4,  4,  3,  3,  3,  3,  5,  5,  3, 12,  4, 10, 14, 14,
+/* 4 */   2,  0,  0,  2,  2,  0,  2,  2,  2,  2,  2,  0,  2,  2,  0,  2,
+/* 5 */   2,  0,  0,  2,  2,  0,  2,  2,  2,  2,  2,  0,  2,  2,  0,  2,
+/* 6 */   6,  0,  0,  6,  6,  0,  6,  6,  6,  6,  6,  0,  6,  6,  3,  6,
+/* 7 */   6,  0,  0,  6,  6,  0,  6,  6,  6,  6,  6,  0,  6,  6,  3,  6,
+/* 8 */   2,  2,  2,  4,  2,  2,  2,  0,  2,  2,  2,  2,  4,  6,  3,  3,
+/* 9 */   3,  3,  3,  5,  3,  3,  3,  3,  3,  3,  3,  3,  5,  5,  4,  4,
+/* A */   4,  4,  4,  6,  4,  4,  4,  4,  4,  4,  4,  4,  6,  6,  5,  5,
+/* B */   4,  4,  4,  6,  4,  4,  4,  4,  4,  4,  4,  4,  6,  6,  5,  5,
+/* C */   2,  2,  2,  4,  2,  2,  2,  0,  2,  2,  2,  2,  3,  0,  3,  2,
+/* D */   3,  3,  3,  5,  3,  3,  3,  3,  3,  3,  3,  3,  4,  4,  4,  4,
+/* E */   4,  4,  4,  6,  4,  4,  4,  4,  4,  4,  4,  4,  5,  5,  5,  5,
+/* F */   4,  4,  4,  6,  4,  4,  4,  4,  4,  4,  4,  4,  5,  5,  5,  5
+};
+
+// Prefixed pages, {opcode, cycles}
+static const unsigned char page18List[][2] = {
+    {0x08,4},{0x09,4},{0x1C,8},{0x1D,8},{0x1E,8},{0x1F,8},{0x30,4},{0x35,4},{0x38,6},{0x3A,4},{0x3C,5},
+    {0x60,7},{0x63,7},{0x64,7},{0x66,7},{0x67,7},{0x68,7},{0x69,7},{0x6A,7},{0x6C,7},{0x6D,7},{0x6E,4},{0x6F,7},
+    {0x8C,5},{0x8F,4},{0x9C,6},
+    {0xA0,5},{0xA1,5},{0xA2,5},{0xA3,7},{0xA4,5},{0xA5,5},{0xA6,5},{0xA7,5},
+    {0xA8,5},{0xA9,5},{0xAA,5},{0xAB,5},{0xAC,7},{0xAD,7},{0xAE,6},{0xAF,6},
+    {0xBC,7},{0xCE,4},{0xDE,5},{0xDF,5},
+    {0xE0,5},{0xE1,5},{0xE2,5},{0xE3,7},{0xE4,5},{0xE5,5},{0xE6,5},{0xE7,5},
+    {0xE8,5},{0xE9,5},{0xEA,5},{0xEB,5},{0xEC,6},{0xED,6},{0xEE,6},{0xEF,6},
+    {0xFE,6},{0xFF,6}
+};
+static const unsigned char page1AList[][2] = {
+    {0x83,5},{0x93,6},{0xA3,7},{0xAC,7},{0xB3,7},{0xEE,6},{0xEF,6}
+};
+static const unsigned char pageCDList[][2] = {
+    {0xA3,7},{0xAC,7},{0xEE,6},{0xEF,6}
+};
+
+static unsigned char page18[256], page1A[256], pageCD[256];
+
+#define cpu hc11Cpu
+#define D() (((unsigned int)cpu.a << 8) | cpu.b)
+
+static void fillPage(unsigned char *page, const unsigned char (*list)[2], int count)
+{
+    int i;
+
+    for(i = 0; i < count; i++){
+        page[list[i][0]] = list[i][1];
+    }
+}
+
+void hc11Reset(void)
+/* Purpose: Clears memory and the CPU, points every ROM interrupt vector at its RAM pseudo vector
+            (0x00C4 upwards, 3 bytes each, as laid out by the board's boot ROM) and resets the peripherals.
+Version: 1.0
+*/{
+    unsigned int vector, pseudo;
+
+    fillPage(page18, page18List, sizeof(page18List) / sizeof(page18List[0]));
+    fillPage(page1A, page1AList, sizeof(page1AList) / sizeof(page1AList[0]));
+    fillPage(pageCD, pageCDList, sizeof(pageCDList) / sizeof(pageCDList[0]));
+
+    for(vector = 0; vector < 0x10000; vector++){
+        hc11Memory[vector] = 0;
+    }
+    for(vector = V_SCI, pseudo = 0xC4; vector < 0xFFFE; vector += 2, pseudo += 3){
+        hc11Memory[vector] = pseudo >> 8;
+        hc11Memory[vector + 1] = pseudo & 0xFF;
+    }
+
+    cpu.a = cpu.b = 0;
+    cpu.x = cpu.y = 0;
+    cpu.ccr = CCR_S | CCR_X | CCR_I;
+    cpu.sp = HC11_STACK_TOP;
+    cpu.pc = HC11_RETURN;
+    hc11Cycles = 0;
+    running = inInterrupt = waiting = 0;
+    periphReset();
+}
+
+unsigned char hc11Read(unsigned int addr)
+{
+    addr &= 0xFFFF;
+    if (addr < HC11_REGS){
+        return periphRead(addr);
+    }
+    return hc11Memory[addr];
+}
+
+void hc11Write(unsigned int addr, unsigned char value)
+{
+    addr &= 0xFFFF;
+    if (addr < HC11_REGS){
+        periphWrite(addr, value);
+    }else{
+        hc11Memory[addr] = value;
+    }
+}
+
+void hc11SetNative(unsigned int addr, void (*handler)(void))
+/* Purpose: Binds a pseudo vector address to a host compiled interrupt handler.
+            When the interrupt is taken the handler is called in place of the code at that address,
+            then the registers are unstacked as if it had executed an RTI.
+Version: 1.0
+*/{
+    int i, free = -1;
+
+    for(i = 0; i < NATIVES; i++){
+        if (natives[i].handler != NULL && natives[i].addr == addr){
+            natives[i].handler = handler;
+            return;
+        }
+        if (natives[i].handler == NULL && free < 0){
+            free = i;
+        }
+    }
+    if (free >= 0 && handler != NULL){
+        natives[free].addr = addr;
+        natives[free].handler = handler;
+    }
+}
+
+static void (*nativeAt(unsigned int addr))(void)
+{
+    int i;
+
+    for(i = 0; i < NATIVES; i++){
+        if (natives[i].handler != NULL && natives[i].addr == addr){
+            return natives[i].handler;
+        }
+    }
+    return NULL;
+}
+
+void hc11Stop(int reason)
+{
+    longjmp(hc11Exit, reason);
+}
+
+int hc11InInterrupt(void)
+{
+    return inInterrupt;
+}
+
+void hc11Advance(unsigned long cycles)
+/* Purpose: Moves the E-clock on, updating the peripherals.
+            When host compiled code is running (not the core) any pending unmasked interrupt is serviced.
+Version: 1.0
+*/{
+    unsigned long long from = hc11Cycles;
+
+    hc11Cycles += cycles;
+    periphAdvance(from, hc11Cycles);
+
+    if (hc11CycleLimit != 0 && hc11Cycles >= hc11CycleLimit){
+        hc11Stop(HC11_STOP_CYCLES);
+    }
+    if (!running){
+        hc11Dispatch();
+    }
+}
+
+// ### Stack and flag helpers ###
+
+static unsigned char fetch(void)
+{
+    unsigned char value = hc11Read(cpu.pc);
+    cpu.pc = (cpu.pc + 1) & 0xFFFF;
+    return value;
+}
+
+static unsigned int fetchWord(void)
+{
+    unsigned int value = fetch() << 8;
+    return value | fetch();
+}
+
+static unsigned int readWord(unsigned int addr)
+{
+    return (hc11Read(addr) << 8) | hc11Read(addr + 1);
+}
+
+static void writeWord(unsigned int addr, unsigned int value)
+{
+    hc11Write(addr, value >> 8);
+    hc11Write(addr + 1, value & 0xFF);
+}
+
+static void push(unsigned char value)
+{
+    hc11Write(cpu.sp, value);
+    cpu.sp = (cpu.sp - 1) & 0xFFFF;
+}
+
+static unsigned char pull(void)
+{
+    cpu.sp = (cpu.sp + 1) & 0xFFFF;
+    return hc11Read(cpu.sp);
+}
+
+static void pushWord(unsigned int value)
+{
+    push(value & 0xFF);
+    push(value >> 8);
+}
+
+static unsigned int pullWord(void)
+{
+    unsigned int value = pull() << 8;
+    return value | pull();
+}
+
+static void setD(unsigned int value)
+{
+    cpu.a = (value >> 8) & 0xFF;
+    cpu.b = value & 0xFF;
+}
+
+static void flag(unsigned char bit, int set)
+{
+    if (set){
+        cpu.ccr |= bit;
+    }else{
+        cpu.ccr &= ~bit;
+    }
+}
+
+static void setNZ8(unsigned int result)
+{
+    flag(CCR_N, result & 0x80);
+    flag(CCR_Z, (result & 0xFF) == 0);
+}
+
+static void setNZ16(unsigned int result)
+{
+    flag(CCR_N, result & 0x8000);
+    flag(CCR_Z, (result & 0xFFFF) == 0);
+}
+
+static void load8(unsigned char *reg, unsigned int value)
+{
+    *reg = value & 0xFF;
+    setNZ8(value);
+    cpu.ccr &= ~CCR_V;
+}
+
+static unsigned char add8(unsigned int a, unsigned int m, unsigned int carry)
+{
+    unsigned int r = (a + m + carry) & 0xFF;
+    unsigned int c = (a & m) | (m & ~r) | (~r & a);
+
+    flag(CCR_H, c & 0x08);
+    flag(CCR_C, c & 0x80);
+    flag(CCR_V, ((a & m & ~r) | (~a & ~m & r)) & 0x80);
+    setNZ8(r);
+    return r;
+}
+
+static unsigned char sub8(unsigned int a, unsigned int m, unsigned int carry)
+{
+    unsigned int r = (a - m - carry) & 0xFF;
+
+    flag(CCR_C, ((~a & m) | (m & r) | (r & ~a)) & 0x80);
+    flag(CCR_V, ((a & ~m & ~r) | (~a & m & r)) & 0x80);
+    setNZ8(r);
+    return r;
+}
+
+static unsigned int add16(unsigned int a, unsigned int m)
+{
+    unsigned int r = (a + m) & 0xFFFF;
+
+    flag(CCR_C, ((a & m) | (m & ~r) | (~r & a)) & 0x8000);
+    flag(CCR_V, ((a & m & ~r) | (~a & ~m & r)) & 0x8000);
+    setNZ16(r);
+    return r;
+}
+
+static unsigned int sub16(unsigned int a, unsigned int m)
+{
+    unsigned int r = (a - m) & 0xFFFF;
+
+    flag(CCR_C, ((~a & m) | (m & r) | (r & ~a)) & 0x8000);
+    flag(CCR_V, ((a & ~m & ~r) | (~a & m & r)) & 0x8000);
+    setNZ16(r);
+    return r;
+}
+
+static unsigned char rmw(int operation, unsigned int value)
+// Shared by the accumulator (0x40/0x50) and memory (0x60/0x70) read-modify-write rows
+{
+    unsigned int r = value;
+    int carry = cpu.ccr & CCR_C;
+
+    switch (operation) {
+        case 0x0: // NEG
+            return sub8(0, value, 0);
+        case 0x3: // COM
+            r = ~value & 0xFF;
+            cpu.ccr = (cpu.ccr & ~CCR_V) | CCR_C;
+            break;
+        case 0x4: // LSR
+            r = value >> 1;
+            flag(CCR_C, value & 1);
+            break;
+        case 0x6: // ROR
+            r = (value >> 1) | (carry ? 0x80 : 0);
+            flag(CCR_C, value & 1);
+            break;
+        case 0x7: // ASR
+            r = (value >> 1) | (value & 0x80);
+            flag(CCR_C, value & 1);
+            break;
+        case 0x8: // ASL
+            r = (value << 1) & 0xFF;
+            flag(CCR_C, value & 0x80);
+            break;
+        case 0x9: // ROL
+            r = ((value << 1) | (carry ? 1 : 0)) & 0xFF;
+            flag(CCR_C, value & 0x80);
+            break;
+        case 0xA: // DEC
+            r = (value - 1) & 0xFF;
+            flag(CCR_V, value == 0x80);
+            setNZ8(r);
+            return r;
+        case 0xC: // INC
+            r = (value + 1) & 0xFF;
+            flag(CCR_V, value == 0x7F);
+            setNZ8(r);
+            return r;
+        case 0xD: // TST
+            cpu.ccr &= ~(CCR_V | CCR_C);
+            break;
+        case 0xF: // CLR
+            r = 0;
+            cpu.ccr &= ~(CCR_V | CCR_C);
+            break;
+    }
+    setNZ8(r);
+    if (operation == 0x4 || operation == 0x6 || operation == 0x7 || operation == 0x8 || operation == 0x9){
+        flag(CCR_V, ((cpu.ccr & CCR_N) != 0) != ((cpu.ccr & CCR_C) != 0));
+    }
+    return r;
+}
+
+static int branchTaken(int condition)
+{
+    int c = (cpu.ccr & CCR_C) != 0, z = (cpu.ccr & CCR_Z) != 0;
+    int n = (cpu.ccr & CCR_N) != 0, v = (cpu.ccr & CCR_V) != 0;
+
+    switch (condition) {
+        case 0x0: return 1;             // BRA
+        case 0x1: return 0;             // BRN
+        case 0x2: return !(c || z);     // BHI
+        case 0x3: return c || z;        // BLS
+        case 0x4: return !c;            // BCC
+        case 0x5: return c;             // BCS
+        case 0x6: return !z;            // BNE
+        case 0x7: return z;             // BEQ
+        case 0x8: return !v;            // BVC
+        case 0x9: return v;             // BVS
+        case 0xA: return !n;            // BPL
+        case 0xB: return n;             // BMI
+        case 0xC: return n == v;        // BGE
+        case 0xD: return n != v;        // BLT
+        case 0xE: return !z && n == v;  // BGT
+        default:  return z || n != v;   // BLE
+    }
+}
+
+static void stackRegisters(void)
+{
+    pushWord(cpu.pc);
+    pushWord(cpu.y);
+    pushWord(cpu.x);
+    push(cpu.a);
+    push(cpu.b);
+    push(cpu.ccr);
+}
+
+static void unstackRegisters(void)
+{
+    unsigned char ccr = pull();
+
+    if (!(cpu.ccr & CCR_X)){
+        ccr &= ~CCR_X; // X can only be cleared by software
+    }
+    cpu.ccr = ccr;
+    cpu.b = pull();
+    cpu.a = pull();
+    cpu.x = pullWord();
+    cpu.y = pullWord();
+    cpu.pc = pullWord();
+}
+
+static void vector(unsigned int vector)
+// Registers are already stacked, enter the handler held in the pseudo vector
+{
+    unsigned int target = readWord(vector);
+    void (*handler)(void) = nativeAt(target);
+
+    cpu.ccr |= CCR_I;
+    if (handler != NULL){
+        int wasRunning = running;
+
+        hc11InterruptFrame = cpu.sp + 1;    // CCR, B, A, X, Y then PC
+        running = 0;                        // The handler is host code, let it take nested interrupts
+        inInterrupt++;
+        handler();
+        inInterrupt--;
+        running = wasRunning;
+        unstackRegisters();
+        hc11Advance(page0[0x3B]);
+    }else if (hc11Read(target) == 0x7E){ // JMP
+        cpu.pc = target;
+    }else{
+        hc11Stop(HC11_STOP_VECTOR);
+    }
+}
+
+void hc11Dispatch(void)
+/* Purpose: Services a pending interrupt while host compiled code is in the foreground.
+            Native handlers are called directly over a stacked frame returning to the sentinel,
+            target code handlers are run on the core until their RTI returns to the sentinel address.
+            A native handler that clears I can itself be interrupted, as on the chip.
+Version: 1.1
+*/{
+    unsigned int pending, target;
+    void (*handler)(void);
+    Hc11Cpu saved;
+
+    if ((cpu.ccr & CCR_I) || (pending = periphPending()) == 0){
+        return;
+    }
+    target = readWord(pending);
+    if ((handler = nativeAt(target)) != NULL){
+        saved = cpu;
+        cpu.pc = HC11_RETURN;               // Stack a real frame so the handler can look at it
+        stackRegisters();
+        cpu.ccr |= CCR_I;
+        hc11InterruptFrame = cpu.sp + 1;
+        inInterrupt++;
+        handler();
+        inInterrupt--;
+        cpu = saved;
+        return;
+    }
+
+    saved = cpu;
+    cpu.pc = HC11_RETURN;
+    stackRegisters();
+    hc11Advance(INTERRUPT_CYCLES);
+    running = 1;
+    vector(pending);
+    while(cpu.pc != HC11_RETURN){
+        hc11Step();
+    }
+    running = 0;
+    cpu = saved;
+}
+
+int hc11Call(unsigned int addr)
+/* Purpose: Calls target code at addr as a subroutine (JSR), running the core until it returns.
+Version: 1.0
+*/{
+    int wasRunning = running;
+
+    pushWord(HC11_RETURN);
+    cpu.pc = addr & 0xFFFF;
+    running = 1;
+    while(cpu.pc != HC11_RETURN){
+        hc11Step();
+    }
+    running = wasRunning;
+    return HC11_STOP_RETURN;
+}
+
+// ### Execution ###
+
+static unsigned int operandAddress(int mode, unsigned int index)
+{
+    switch (mode) {
+        case 1: // DIR
+            return fetch();
+        case 2: // IND
+            return (index + fetch()) & 0xFFFF;
+        default: // EXT
+            return fetchWord();
+    }
+}
+
+static void executeInherent(unsigned int op, unsigned int *reg)
+// 0x00 - 0x3F, excluding the bit manipulation instructions
+{
+    unsigned int value;
+    unsigned char ccr;
+    unsigned long quotient;
+    signed char rel;
+
+    switch (op) {
+        case 0x01: break; // NOP
+        case 0x02: // IDIV
+            value = D();
+            if (cpu.x == 0){
+                cpu.x = 0xFFFF;
+                cpu.ccr |= CCR_C;
+            }else{
+                setD(value % cpu.x);
+                cpu.x = value / cpu.x;
+                cpu.ccr &= ~CCR_C;
+            }
+            cpu.ccr &= ~CCR_V;
+            flag(CCR_Z, cpu.x == 0);
+            break;
+        case 0x03: // FDIV
+            value = D();
+            cpu.ccr &= ~(CCR_V | CCR_C);
+            if (cpu.x == 0){
+                cpu.x = 0xFFFF;
+                cpu.ccr |= CCR_C;
+            }else if (cpu.x <= value){
+                cpu.x = 0xFFFF;
+                cpu.ccr |= CCR_V;
+            }else{
+                quotient = ((unsigned long)value << 16) / cpu.x;
+                setD(((unsigned long)value << 16) % cpu.x);
+                cpu.x = quotient & 0xFFFF;
+            }
+            flag(CCR_Z, cpu.x == 0);
+            break;
+        case 0x04: // LSRD
+            value = D();
+            flag(CCR_C, value & 1);
+            setD(value >> 1);
+            setNZ16(value >> 1);
+            flag(CCR_V, cpu.ccr & CCR_C);
+            break;
+        case 0x05: // ASLD
+            value = D();
+            flag(CCR_C, value & 0x8000);
+            setD((value << 1) & 0xFFFF);
+            setNZ16(value << 1);
+            flag(CCR_V, ((cpu.ccr & CCR_N) != 0) != ((cpu.ccr & CCR_C) != 0));
+            break;
+        case 0x06: // TAP
+            ccr = cpu.a;
+            if (!(cpu.ccr & CCR_X)){
+                ccr &= ~CCR_X;
+            }
+            cpu.ccr = ccr;
+            break;
+        case 0x07: cpu.a = cpu.ccr; break; // TPA
+        case 0x08: *reg = (*reg + 1) & 0xFFFF; flag(CCR_Z, *reg == 0); break; // INX/INY
+        case 0x09: *reg = (*reg - 1) & 0xFFFF; flag(CCR_Z, *reg == 0); break; // DEX/DEY
+        case 0x0A: cpu.ccr &= ~CCR_V; break;
+        case 0x0B: cpu.ccr |= CCR_V; break;
+        case 0x0C: cpu.ccr &= ~CCR_C; break;
+        case 0x0D: cpu.ccr |= CCR_C; break;
+        case 0x0E: cpu.ccr &= ~CCR_I; break;
+        case 0x0F: cpu.ccr |= CCR_I; break;
+        case 0x10: cpu.a = sub8(cpu.a, cpu.b, 0); break; // SBA
+        case 0x11: sub8(cpu.a, cpu.b, 0); break; // CBA
+        case 0x16: load8(&cpu.b, cpu.a); break; // TAB
+        case 0x17: load8(&cpu.a, cpu.b); break; // TBA
+        case 0x19: // DAA
+            value = 0;
+            ccr = cpu.ccr & CCR_C;
+            if ((cpu.ccr & CCR_H) || (cpu.a & 0x0F) > 9){
+                value |= 0x06;
+            }
+            if (ccr || (cpu.a >> 4) > 9 || ((cpu.a >> 4) > 8 && (cpu.a & 0x0F) > 9)){
+                value |= 0x60;
+                ccr = CCR_C;
+            }
+            cpu.a = (cpu.a + value) & 0xFF;
+            setNZ8(cpu.a);
+            flag(CCR_C, ccr);
+            break;
+        case 0x1B: cpu.a = add8(cpu.a, cpu.b, 0); break; // ABA
+        case 0x30: *reg = (cpu.sp + 1) & 0xFFFF; break; // TSX/TSY
+        case 0x31: cpu.sp = (cpu.sp + 1) & 0xFFFF; break; // INS
+        case 0x32: cpu.a = pull(); break;
+        case 0x33: cpu.b = pull(); break;
+        case 0x34: cpu.sp = (cpu.sp - 1) & 0xFFFF; break; // DES
+        case 0x35: cpu.sp = (*reg - 1) & 0xFFFF; break; // TXS/TYS
+        case 0x36: push(cpu.a); break;
+        case 0x37: push(cpu.b); break;
+        case 0x38: *reg = pullWord(); break; // PULX/PULY
+        case 0x39: cpu.pc = pullWord(); break; // RTS
+        case 0x3A: *reg = (*reg + cpu.b) & 0xFFFF; break; // ABX/ABY
+        case 0x3B: unstackRegisters(); break; // RTI
+        case 0x3C: pushWord(*reg); break; // PSHX/PSHY
+        case 0x3D: // MUL
+            setD(cpu.a * cpu.b);
+            flag(CCR_C, cpu.b & 0x80);
+            break;
+        case 0x3E: // WAI
+            stackRegisters();
+            waiting = 1;
+            break;
+        case 0x3F: // SWI
+            stackRegisters();
+            vector(V_SWI);
+            break;
+        default: // Branches 0x20 - 0x2F
+            rel = (signed char)fetch();
+            if (branchTaken(op & 0x0F)){
+                cpu.pc = (cpu.pc + rel) & 0xFFFF;
+            }
+            break;
+    }
+}
+
+static void executeBit(unsigned int op, unsigned int index)
+// BSET/BCLR/BRSET/BRCLR in direct (0x12 - 0x15) and indexed (0x1C - 0x1F) modes
+{
+    unsigned int ea, mask, value;
+    signed char rel;
+    int operation = (op < 0x1C) ? op - 0x12 : ((op - 0x1C) ^ 2); // 0 BRSET, 1 BRCLR, 2 BSET, 3 BCLR
+
+    ea = operandAddress(op < 0x1C ? 1 : 2, index);
+    value = hc11Read(ea);
+    mask = fetch();
+
+    if (operation < 2){
+        rel = (signed char)fetch();
+        if ((operation == 0 && (~value & mask) == 0) || (operation == 1 && (value & mask) == 0)){
+            cpu.pc = (cpu.pc + rel) & 0xFFFF;
+        }
+        return;
+    }
+    value = ((operation == 2) ? (value | mask) : (value & ~mask)) & 0xFF;
+    setNZ8(value);
+    cpu.ccr &= ~CCR_V;
+    hc11Write(ea, value);
+}
+
+static void executeAlu(unsigned int page, unsigned int op, unsigned int index, unsigned int *reg)
+// 0x80 - 0xFF, columns select the operation, rows the accumulator and addressing mode
+{
+    int mode = (op >> 4) & 3, low = op & 0x0F;
+    int wide = (low == 0x3 || low == 0xC || low == 0xE);
+    unsigned char *acc = (op & 0x40) ? &cpu.b : &cpu.a;
+    unsigned int ea = 0, value = 0, swap;
+    signed char rel;
+
+    if (mode == 0 && low == 0xD){ // BSR
+        rel = (signed char)fetch();
+        pushWord(cpu.pc);
+        cpu.pc = (cpu.pc + rel) & 0xFFFF;
+        return;
+    }
+    if (mode == 0 && low == 0xF){
+        if (op == 0xCF){ // STOP
+            if (!(cpu.ccr & CCR_S)){
+                hc11Stop(HC11_STOP_HALT);
+            }
+        }else{ // XGDX/XGDY
+            swap = *reg;
+            *reg = D();
+            setD(swap);
+        }
+        return;
+    }
+
+    if (mode == 0){
+        value = wide ? fetchWord() : fetch();
+    }else{
+        ea = operandAddress(mode, index);
+        if (low != 0x7 && low != 0xD && low != 0xF){
+            value = wide ? readWord(ea) : hc11Read(ea);
+        }
+    }
+
+    switch (low) {
+        case 0x0: *acc = sub8(*acc, value, 0); break;
+        case 0x1: sub8(*acc, value, 0); break;
+        case 0x2: *acc = sub8(*acc, value, cpu.ccr & CCR_C); break;
+        case 0x3:
+            if (op & 0x40){
+                setD(add16(D(), value)); // ADDD
+            }else if (page == 0x1A || page == 0xCD){
+                sub16(D(), value); // CPD
+            }else{
+                setD(sub16(D(), value)); // SUBD
+            }
+            break;
+        case 0x4: load8(acc, *acc & value); break;
+        case 0x5: setNZ8(*acc & value); cpu.ccr &= ~CCR_V; break;
+        case 0x6: load8(acc, value); break;
+        case 0x7: load8(acc, *acc); hc11Write(ea, *acc); break;
+        case 0x8: load8(acc, *acc ^ value); break;
+        case 0x9: *acc = add8(*acc, value, cpu.ccr & CCR_C); break;
+        case 0xA: load8(acc, *acc | value); break;
+        case 0xB: *acc = add8(*acc, value, 0); break;
+        case 0xC:
+            if (op & 0x40){
+                setD(value); // LDD
+            }else{
+                sub16(*reg, value); // CPX/CPY
+                break;
+            }
+            setNZ16(value);
+            cpu.ccr &= ~CCR_V;
+            break;
+        case 0xD:
+            if (op & 0x40){ // STD
+                writeWord(ea, D());
+                setNZ16(D());
+                cpu.ccr &= ~CCR_V;
+            }else{ // JSR
+                pushWord(cpu.pc);
+                cpu.pc = ea;
+            }
+            break;
+        case 0xE:
+            if (op & 0x40){
+                *reg = value; // LDX/LDY
+            }else{
+                cpu.sp = value; // LDS
+            }
+            setNZ16(value);
+            cpu.ccr &= ~CCR_V;
+            break;
+        case 0xF:
+            value = (op & 0x40) ? *reg : cpu.sp; // STX/STY or STS
+            writeWord(ea, value);
+            setNZ16(value);
+            cpu.ccr &= ~CCR_V;
+            break;
+    }
+}
+
+int hc11Step(void)
+/* Purpose: Executes a single instruction (or takes a pending interrupt) and advances the clock.
+            Returns the number of E-clock cycles used.
+Version: 1.0
+*/{
+    unsigned int op, page = 0, pending, *index, *reg;
+    int cycles;
+
+    pending = (cpu.ccr & CCR_I) ? 0 : periphPending();
+    if (waiting){
+        if (!pending){
+            hc11Advance(1);
+            return 1;
+        }
+        waiting = 0;
+        vector(pending);
+        hc11Advance(INTERRUPT_CYCLES);
+        return INTERRUPT_CYCLES;
+    }
+    if (pending){
+        stackRegisters();
+        vector(pending);
+        hc11Advance(INTERRUPT_CYCLES);
+        return INTERRUPT_CYCLES;
+    }
+
+    op = fetch();
+    if (op == 0x18 || op == 0x1A || op == 0xCD){
+        page = op;
+        op = fetch();
+        cycles = (page == 0x18) ? page18[op] : (page == 0x1A) ? page1A[op] : pageCD[op];
+    }else{
+        cycles = page0[op];
+    }
+
+    if (cycles == 0){ // Illegal opcode trap
+        stackRegisters();
+        vector(V_ILLOP);
+        hc11Advance(INTERRUPT_CYCLES);
+        return INTERRUPT_CYCLES;
+    }
+
+    // Indexed addressing uses Y on pages 0x18/0xCD, X/Y register instructions name Y on pages 0x18/0x1A
+    index = (page == 0x18 || page == 0xCD) ? &cpu.y : &cpu.x;
+    reg = (page == 0x18 || page == 0x1A) ? &cpu.y : &cpu.x;
+
+    if (op >= 0x80){
+        executeAlu(page, op, *index, reg);
+    }else if (op >= 0x60){
+        unsigned int ea = operandAddress(op < 0x70 ? 2 : 3, *index);
+        if ((op & 0x0F) == 0x0E){ // JMP
+            cpu.pc = ea;
+        }else if ((op & 0x0F) == 0x0D){ // TST
+            rmw(0xD, hc11Read(ea));
+        }else{
+            hc11Write(ea, rmw(op & 0x0F, hc11Read(ea)));
+        }
+    }else if (op >= 0x40){
+        if (op < 0x50){
+            cpu.a = rmw(op & 0x0F, cpu.a);
+        }else{
+            cpu.b = rmw(op & 0x0F, cpu.b);
+        }
+    }else if ((op >= 0x12 && op <= 0x15) || (op >= 0x1C && op <= 0x1F)){
+        executeBit(op, *index);
+    }else{
+        executeInherent(op, reg);
+    }
+
+    hc11Advance(cycles);
+    return cycles;
+}
@@ -0,0 +1,105 @@
+#ifndef HC11_H
+#define HC11_H
+
+/*Purpose: Host side 68HC11 simulator.
+            A 68HC11 core that counts E-clock cycles, together with a model of the
+            register block the monitor uses (SCI, Port A, ADC and the main timer).
+            Registers are mapped at 0x0000 as on the board, RAM fills the rest of the 64K map.
+*/
+
+#include <setjmp.h>
+#include "../hc11regs.h"     // Register offsets, shared with main.c and servo.c
+
+#define HC11_E_CLOCK    2000000UL   // 8MHz crystal / 4
+#define HC11_REGS       0x40        // Size of the register block at 0x0000
+#define HC11_RETURN     0xFFFF      // Sentinel return address used by hc11Call()
+#define HC11_STACK_TOP  0x7DFF      // Top of the monitor stack (MAX in main.c)
+#define HC11_ACCESS     4           // Cycles charged for a register access from host compiled code (extended load/store)
+#define HC11_IDLE       9           // Cycles charged for each pass of a wait loop in host compiled code
+
+// CCR bits
+#define CCR_S 0x80
+#define CCR_X 0x40
+#define CCR_H 0x20
+#define CCR_I 0x10
+#define CCR_N 0x08
+#define CCR_Z 0x04
+#define CCR_V 0x02
+#define CCR_C 0x01
+
+// Interrupt vectors (ROM), each points at a 3 byte pseudo vector in RAM as on the board
+#define V_SCI    0xFFD6
+#define V_TOF    0xFFDE
+#define V_TOC5   0xFFE0
+#define V_TOC4   0xFFE2
+#define V_TOC3   0xFFE4
+#define V_TOC2   0xFFE6
+#define V_TOC1   0xFFE8
+#define V_RTI    0xFFF0
+#define V_IRQ    0xFFF2
+#define V_XIRQ   0xFFF4
+#define V_SWI    0xFFF6
+#define V_ILLOP  0xFFF8
+
+// Reasons for leaving a simulation run (hc11Stop / hc11Call)
+#define HC11_STOP_RETURN  0     // Subroutine returned
+#define HC11_STOP_INPUT   1     // Script input exhausted while the monitor waits for input
+#define HC11_STOP_CYCLES  2     // Cycle limit reached
+#define HC11_STOP_HALT    3     // STOP instruction executed
+#define HC11_STOP_VECTOR  4     // Interrupt taken with nothing installed in its pseudo vector
+
+typedef struct{
+    unsigned char a, b, ccr;
+    unsigned int x, y, sp, pc;
+}Hc11Cpu;
+
+extern unsigned char hc11Memory[0x10000];
+extern Hc11Cpu hc11Cpu;
+extern unsigned long long hc11Cycles;
+extern unsigned long long hc11CycleLimit;
+extern unsigned int hc11InterruptFrame;
+extern jmp_buf hc11Exit;
+
+// Core (hc11.c)
+void hc11Reset(void);
+unsigned char hc11Read(unsigned int addr);
+void hc11Write(unsigned int addr, unsigned char value);
+int hc11Step(void);
+int hc11Call(unsigned int addr);
+void hc11SetNative(unsigned int addr, void (*handler)(void));
+void hc11Dispatch(void);
+void hc11Advance(unsigned long cycles);
+void hc11Stop(int reason);
+int hc11InInterrupt(void);
+
+// Peripherals (periph.c)
+void periphReset(void);
+unsigned char periphRead(unsigned int reg);
+void periphWrite(unsigned int reg, unsigned char value);
+void periphAdvance(unsigned long long from, unsigned long long to);
+unsigned int periphPending(void);
+
+// SCI line model (periph.c)
+typedef struct{
+    unsigned long baud;
+    int stream;             // Send the script after its first line back to back instead of line by line
+    int echo;               // Copy transmitted characters to stdout
+    int timing;             // Report cycles taken by each script line
+    int input;              // What happens when the script runs out, SCI_SCRIPT, SCI_LINES, SCI_KEYS or SCI_PORT
+    int port;               // SCI_PORT, file descriptor the SCI reads and writes instead of stdin and stdout
+}SciConfig;
+
+#define SCI_SCRIPT 0        // Stop the simulator
+#define SCI_LINES  1        // Read the next line from stdin
+#define SCI_KEYS   2        // Read the next key from stdin (a terminal in raw mode)
+#define SCI_PORT   3        // Read whatever has arrived on port (a pseudo terminal), and send output there
+
+void sciConfigure(const SciConfig *config);
+void sciInput(const unsigned char *data, unsigned long length);
+void sciIdle(void);
+void sciDrain(void);
+void sciReport(void);
+unsigned long sciCharCycles(void);
+void adcInput(unsigned char value);
+
+#endif
@@ -0,0 +1,312 @@
+/*Purpose: lbsend - sends an S-record file to the monitor's lb (binary load) command.
+            Each run of bytes is split into frames of SOH, address, length, data and CRC16 (see lb() in main.c),
+            waiting for the ACK of each frame and resending it on a NAK.
+            With -o the frames are written to a file instead, ready to feed to hc11sim (-r -s).
+            With -z the data is packed into STX frames, literal runs and copies of up to 130 bytes from the
+            last 256 bytes of the same frame, which the monitor unpacks once the frame's CRC is good (unpack() in main.c).
+            Zero filled tables and repeated code then cost a few bytes each, random data about 1% more.
+
+Usage: lbsend [-b baud] [-n size] [-o file] [-z] file.s19 [device]
+            -b  Serial port baud rate (default 9600)
+            -n  Data bytes per frame, 1-255 (default 128), packed bytes per frame with -z
+            -o  Write "lb", the frames and EOT to file instead of sending them
+            -z  Send packed frames
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include "srec.h"
+
+#define SOH 0x01
+#define STX 0x02
+#define EOT 0x04
+#define ACK 0x06
+#define NAK 0x15
+#define CAN 0x18
+#define RETRIES 10
+#define TIMEOUT_MS 2000
+#define LITERALS 128            // Longest literal run, control byte 00-7F
+#define MATCH_MIN 3             // Shortest copy, control byte 80-FF
+#define MATCH_MAX 130
+#define WINDOW 256              // Furthest copy back, distance byte 00-FF
+
+static unsigned char image[0x10000], loaded[0x10000];
+
+static void loadRecord(unsigned long addr, const unsigned char *data, int length, void *context)
+{
+    int i;
+
+    for(i = 0; i < length; i++){
+        image[(addr + i) & 0xFFFF] = data[i];
+        loaded[(addr + i) & 0xFFFF] = 1;
+    }
+}
+
+static unsigned int crc16(unsigned int crc, unsigned char data)
+// Same CRC-16/CCITT as the monitor
+{
+    int i;
+
+    crc ^= (unsigned int)data << 8;
+    for(i = 0; i < 8; i++){
+        crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+    return crc & 0xFFFF;
+}
+
+static int pack(unsigned char *packed, int limit, unsigned long start, unsigned long end, unsigned long *consumed)
+// Packs as much of start -> end as fits in limit bytes, greedily taking the longest copy at each byte.
+// Copies only reach back to start, the monitor has nothing earlier to copy from
+{
+    unsigned long pos = start, literalStart = start;
+    int size = 0, literals = 0, best, bestDistance = 0, length, distance;
+
+    while(pos < end){
+        best = 0;
+        for(distance = 1; distance <= WINDOW && (unsigned long)distance <= pos - start; distance++){
+            for(length = 0; length < MATCH_MAX && pos + length < end && image[pos + length - distance] == image[pos + length]; length++);
+            if (length > best){
+                best = length;
+                bestDistance = distance;
+            }
+        }
+
+        if (best >= MATCH_MIN){
+            if (size + (literals ? literals + 1 : 0) + 2 > limit){
+                break;
+            }
+            if (literals){
+                packed[size++] = literals - 1;
+                memcpy(packed + size, image + literalStart, literals);
+                size += literals;
+                literals = 0;
+            }
+            packed[size++] = 0x80 | (best - MATCH_MIN);
+            packed[size++] = bestDistance - 1;
+            pos += best;
+        }else{
+            if (size + literals + 2 > limit){   // This literal and the run's control byte
+                break;
+            }
+            if (literals == 0){
+                literalStart = pos;
+            }
+            literals++;
+            pos++;
+            if (literals == LITERALS){
+                packed[size++] = literals - 1;
+                memcpy(packed + size, image + literalStart, literals);
+                size += literals;
+                literals = 0;
+            }
+        }
+    }
+    if (literals){
+        packed[size++] = literals - 1;
+        memcpy(packed + size, image + literalStart, literals);
+        size += literals;
+    }
+    *consumed = pos - start;
+    return size;
+}
+
+static int buildFrame(unsigned char *frame, unsigned int address, const unsigned char *data, int length, int type)
+{
+    unsigned int crc = 0xFFFF;
+    int i, size = 0;
+
+    frame[size++] = type;
+    frame[size++] = address >> 8;
+    frame[size++] = address & 0xFF;
+    frame[size++] = length;
+    memcpy(frame + size, data, length);
+    size += length;
+    for(i = 1; i < size; i++){
+        crc = crc16(crc, frame[i]);
+    }
+    frame[size++] = crc >> 8;
+    frame[size++] = crc & 0xFF;
+    return size;
+}
+
+static speed_t baudRate(unsigned long baud)
+{
+    switch (baud) {
+        case 1200: return B1200;
+        case 2400: return B2400;
+        case 4800: return B4800;
+        case 9600: return B9600;
+        case 19200: return B19200;
+        case 38400: return B38400;
+        case 57600: return B57600;
+        case 115200: return B115200;
+    }
+    fprintf(stderr, "lbsend: unsupported baud rate %lu\n", baud);
+    exit(2);
+}
+
+static int openPort(const char *device, unsigned long baud)
+{
+    struct termios tio;
+    int fd;
+
+    if ((fd = open(device, O_RDWR | O_NOCTTY)) < 0 || tcgetattr(fd, &tio) < 0){
+        perror(device);
+        exit(2);
+    }
+    cfmakeraw(&tio);
+    cfsetispeed(&tio, baudRate(baud));
+    cfsetospeed(&tio, baudRate(baud));
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 1;
+    if (tcsetattr(fd, TCSANOW, &tio) < 0){
+        perror(device);
+        exit(2);
+    }
+    tcflush(fd, TCIOFLUSH);
+    return fd;
+}
+
+static double now(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static int reply(int fd)
+// Waits for ACK, NAK or CAN from the monitor, anything else (its header text) is skipped. -1 on timeout
+{
+    unsigned char c;
+    double until = now() + TIMEOUT_MS / 1000.0;
+
+    while(now() < until){
+        if (read(fd, &c, 1) == 1 && (c == ACK || c == NAK || c == CAN)){
+            return c;
+        }
+    }
+    return -1;
+}
+
+static void writeAll(int fd, const unsigned char *data, int length)
+{
+    int done;
+
+    while(length > 0){
+        if ((done = write(fd, data, length)) < 0){
+            perror("lbsend");
+            exit(1);
+        }
+        data += done;
+        length -= done;
+    }
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "Usage: lbsend [-b baud] [-n size] [-o file] [-z] file.s19 [device]\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned char frame[4 + 255 + 2], packed[255];
+    unsigned long baud = 9600, bytes = 0, sent = 0, address, end, run;
+    int block = 128, compress = 0, option, size, length, tries, answer, fd = -1;
+    unsigned int frames = 0, resent = 0;
+    const char *output = NULL;
+    FILE *file = NULL;
+    double start;
+
+    while((option = getopt(argc, argv, "b:n:o:z")) != -1){
+        switch (option) {
+            case 'b': baud = strtoul(optarg, NULL, 0); break;
+            case 'n': block = atoi(optarg); break;
+            case 'o': output = optarg; break;
+            case 'z': compress = 1; break;
+            default: usage();
+        }
+    }
+    if (block < (compress ? 2 : 1) || block > 255 || optind >= argc || optind + 2 < argc || (output == NULL) == (optind + 1 == argc)){
+        usage();
+    }
+    if (srecRead(argv[optind], loadRecord, NULL, NULL) < 0){
+        return 2;
+    }
+
+    if (output){
+        if ((file = fopen(output, "wb")) == NULL){
+            perror(output);
+            return 2;
+        }
+        fputs("lb\n", file);
+    }else{
+        fd = openPort(argv[optind + 1], baud);
+        writeAll(fd, (const unsigned char *)"lb\r", 3);
+        if (reply(fd) != NAK){
+            fprintf(stderr, "lbsend: no answer from the monitor\n");
+            return 1;
+        }
+    }
+
+    start = now();
+    for(address = 0; address < 0x10000; address = end){
+        if (!loaded[address]){
+            end = address + 1;
+            continue;
+        }
+        if (compress){
+            for(end = address; end < 0x10000 && loaded[end]; end++);
+            length = pack(packed, block, address, end, &run);
+            end = address + run;
+            size = buildFrame(frame, address, packed, length, STX);
+        }else{
+            for(end = address; end < 0x10000 && loaded[end] && end - address < (unsigned long)block; end++);
+            length = end - address;
+            size = buildFrame(frame, address, image + address, length, SOH);
+        }
+
+        if (file){
+            fwrite(frame, 1, size, file);
+        }else{
+            for(tries = 0; ; tries++){
+                writeAll(fd, frame, size);
+                if ((answer = reply(fd)) == ACK){
+                    break;
+                }
+                if (answer == CAN || tries == RETRIES){
+                    fprintf(stderr, "lbsend: frame %04lX rejected\n", address);
+                    return 1;
+                }
+                resent++;
+            }
+        }
+        frames++;
+        bytes += end - address;
+        sent += length;
+    }
+
+    frame[0] = EOT;
+    if (file){
+        fwrite(frame, 1, 1, file);
+        fclose(file);
+    }else{
+        writeAll(fd, frame, 1);
+        if (reply(fd) != ACK){
+            fprintf(stderr, "lbsend: EOT not acknowledged\n");
+            return 1;
+        }
+        close(fd);
+    }
+    fprintf(stderr, "lbsend: %u frames, %lu bytes, %u resent, %.2f s\n", frames, bytes, resent, now() - start);
+    if (compress && bytes){
+        fprintf(stderr, "lbsend: packed to %lu bytes, %lu%%\n", sent, sent * 100 / bytes);
+    }
+    return 0;
+}
@@ -0,0 +1,159 @@
+/*Purpose: mapregions - makes regions.h, the monitor's memory map, from the linker map cram.BAT writes (map.txt).
+            The segment lines of the map ("start 00000400 end 00004f6c length 19308 segment .text") give
+            where the monitor's code (.text, .const) and data (.data, .bss) are, and the rest is the board:
+                0000-003F   I/O, the register block
+                0040-03FF   Page 0, the monitor's zero page variables and the pseudo vectors
+                top of the monitor up to the blocks, free RAM that lf, lb and the memory commands may use
+                7980-stack  The servo.c and prof blocks (SERVO_BLOCK and PROF_BLOCK in main.c)
+                stack       -s bytes (962) below the top of RAM, 7DFF
+                7E00-FFFF   Not RAM
+            Free RAM may be loaded and written, the blocks only written (mm, fill, move, rp), the rest neither.
+            Adjacent regions of the same type are joined, so any write the monitor allows lies inside one region.
+            cram.BAT runs it after each link and links again until regions.h matches the map it was made from.
+            Without a map (the first build) everything from 0400 to the blocks is taken to be the monitor,
+            so nothing may be loaded until there is one. The Makefile makes the simulator's from test/simmap.txt.
+
+Usage: mapregions [-s stack] [map.txt] > regions.h
+            -s  Stack size in bytes (default 962, what the monitor has always kept below 7DFF)
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define LINE_SIZE 256
+#define MAX_REGIONS 32
+#define PAGE0_END 0x03FF
+#define BLOCKS_START 0x7980
+#define RAM_TOP 0x7DFF
+
+// Must match the MEM_ types in main.c, and what each lets the monitor do there
+static const char *types[] = {"MEM_IO", "MEM_PAGE0", "MEM_CODE", "MEM_DATA", "MEM_FREE", "MEM_BLOCKS", "MEM_STACK", "MEM_NONE"};
+static const char *attributes[] = {"0", "0", "0", "0", "MEM_LOAD | MEM_WRITE", "MEM_WRITE", "0", "0"};
+enum {IO, PAGE0, CODE, DATA, FREE, BLOCKS, STACK, NONE};
+
+typedef struct{
+    unsigned long start, end;
+    int type;
+}Region;
+
+static Region regions[MAX_REGIONS];
+static int count;
+
+static void add(unsigned long start, unsigned long end, int type)
+// Regions are added in address order, joining one to the last when it follows on with the same type
+{
+    if (end < start){
+        return;
+    }
+    if (count > 0 && regions[count - 1].type == type && regions[count - 1].end + 1 == start){
+        regions[count - 1].end = end;
+        return;
+    }
+    if (count == MAX_REGIONS){
+        fprintf(stderr, "mapregions: more than %d regions\n", MAX_REGIONS);
+        exit(1);
+    }
+    regions[count].start = start;
+    regions[count].end = end;
+    regions[count++].type = type;
+}
+
+static int compare(const void *a, const void *b)
+{
+    const Region *x = a, *y = b;
+
+    return x->start < y->start ? -1 : x->start > y->start;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "Usage: mapregions [-s stack] [map.txt] > regions.h\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    Region segments[MAX_REGIONS];
+    char line[LINE_SIZE], name[LINE_SIZE];
+    unsigned long start, end, length, stack = 962, next;
+    int option, segmentCount = 0, i;
+    FILE *file;
+
+    while((option = getopt(argc, argv, "s:")) != -1){
+        switch (option) {
+            case 's': stack = strtoul(optarg, NULL, 0); break;
+            default: usage();
+        }
+    }
+    if (optind + 1 < argc || stack == 0 || stack > RAM_TOP - BLOCKS_START){
+        usage();
+    }
+    if (optind == argc){
+        segments[segmentCount].start = PAGE0_END + 1;   // No map yet, all of it is the monitor's
+        segments[segmentCount].end = BLOCKS_START - 1;
+        segments[segmentCount++].type = CODE;
+        file = NULL;
+    }else if ((file = fopen(argv[optind], "r")) == NULL){
+        perror(argv[optind]);
+        return 2;
+    }
+    while(file != NULL && fgets(line, sizeof(line), file) != NULL){
+        if (sscanf(line, " start %lx end %lx length %lu segment %s", &start, &end, &length, name) != 4 || length == 0){
+            continue;
+        }
+        if (end - 1 <= PAGE0_END){
+            continue;   // Zero page segments are inside page 0
+        }
+        if (start <= PAGE0_END){
+            start = PAGE0_END + 1;  // Only the part past page 0 needs a region of its own
+        }
+        if (end - 1 >= BLOCKS_START){
+            fprintf(stderr, "mapregions: segment %s (%04lX-%04lX) runs into the blocks at %04X\n", name, start, end - 1, BLOCKS_START);
+            return 1;
+        }
+        if (segmentCount == MAX_REGIONS){
+            fprintf(stderr, "mapregions: more than %d segments in %s\n", MAX_REGIONS, argv[optind]);
+            return 1;
+        }
+        segments[segmentCount].start = start;
+        segments[segmentCount].end = end - 1;      // The map's end is the byte after
+        segments[segmentCount++].type = strcmp(name, ".text") == 0 || strcmp(name, ".const") == 0 ? CODE : DATA;
+    }
+    if (file != NULL){
+        fclose(file);
+    }
+    if (segmentCount == 0){
+        fprintf(stderr, "mapregions: no segments in %s\n", argv[optind]);
+        return 1;
+    }
+    qsort(segments, segmentCount, sizeof(Region), compare);
+
+    add(0x0000, 0x003F, IO);
+    add(0x0040, PAGE0_END, PAGE0);
+    for(i = 0, next = PAGE0_END + 1; i < segmentCount; i++){
+        add(next, segments[i].start - 1, FREE);
+        add(segments[i].start, segments[i].end, segments[i].type);
+        next = segments[i].end + 1;
+    }
+    add(next, BLOCKS_START - 1, FREE);
+    add(BLOCKS_START, RAM_TOP - stack, BLOCKS);
+    add(RAM_TOP - stack + 1, RAM_TOP, STACK);
+    add(RAM_TOP + 1, 0xFFFF, NONE);
+
+    if (optind == argc){
+        printf("/* Generated by mapregions without a map, nothing may be loaded. cram.BAT remakes it from map.txt.\n");
+    }else{
+        printf("/* Generated by mapregions from %s (cram.BAT remakes the board's after each link).\n", argv[optind]);
+    }
+    printf("   Sorted, and together they cover the whole 64K (see regionFind() in main.c) */\n\n");
+    printf("#define REGIONS %d\n\n", count);
+    printf("const Region regions[REGIONS] = {\n");
+    for(i = 0; i < count; i++){
+        printf("    {0x%04lX, 0x%04lX, %-10s, %s}%s\n", regions[i].start, regions[i].end, types[regions[i].type],
+                attributes[regions[i].type], i + 1 < count ? "," : "");
+    }
+    printf("};\n");
+    return 0;
+}
@@ -0,0 +1,253 @@
+/*Purpose: monbench - times the monitor's own hot paths, main.c built with -DHOST and run against the simulator
+            as hc11sim runs it, but calling the routines directly on fixed inputs instead of through a script.
+                lf        S-record load, ns per KB of S19 text (distest.s19 moved into the lf area, then random records)
+                dis       disassembly of distest.s19, ns per instruction
+                dm        memory display, ns per byte
+                dispatch  handleCommand() on bp/bc lines, ns per command
+            The SCI runs far faster than on the board, so the host time is mostly main.c itself rather than
+            the simulator waiting on characters, and the output is thrown away. Each routine is run several times, in turn
+            with the others so that a busy spell on the machine does not spoil all of one routine's runs, and the quickest
+            run kept. Times are the process's CPU time, and each run is tens of milliseconds (DISPATCHES commands for
+            dispatch), long enough that the clock and scheduler add little.
+            Host nanoseconds depend on the machine, so the baseline to compare against is kept per
+            machine (make bench-baseline) rather than in the repository.
+
+Usage: monbench [-n runs] [-t percent] [-u] [-r seed] distest.s19 [baseline]
+            -n  Runs of each routine, the quickest is kept (default 5)
+            -t  Fail if a routine is this much slower than the baseline (default 10)
+            -u  Write the results to the baseline instead of comparing with it
+            -r  Seed for the random records (default 1, so every run loads the same file)
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "hc11.h"
+#include "srec.h"
+#include "monitor.h"       // main.c, built with -DHOST
+
+#define LF_BAUD 1000000UL       // 20 E-cycles a character, more than sciIsr() takes, so lf loses nothing
+#define FAST_BAUD 20000000UL    // 1 E-cycle a character, the transmit ring never fills for long
+#define LF_BASE 0x6000          // distest.s19 is assembled at 0x4000, lf only loads into free RAM (regions.h)
+#define RANDOM_BYTES 0x1400     // Random data loaded by lf after distest, inside the free region
+#define RECORD_BYTES 32         // Data bytes in each generated S1 record
+#define DM_START 0x4000
+#define DM_BYTES 0x1000
+#define DISPATCHES 500000       // About 30ms a run, 20000 was too short to time steadily
+#define TEXT_SIZE 0x10000
+#define ROUTINES 4
+
+typedef struct{
+    const char *name, *unit;
+    double ns;                  // Quickest run, per unit
+}Result;
+
+static char text[TEXT_SIZE];    // lf input
+static unsigned long textLength;
+static unsigned long disStart, disEnd;
+
+static void appendRecord(unsigned long addr, const unsigned char *data, int length)
+{
+    unsigned char sum = length + 3 + (addr >> 8) + (addr & 0xFF);
+    int i;
+
+    textLength += sprintf(text + textLength, "S1%02X%04lX", length + 3, addr);
+    for(i = 0; i < length; i++){
+        textLength += sprintf(text + textLength, "%02X", data[i]);
+        sum += data[i];
+    }
+    textLength += sprintf(text + textLength, "%02X\n", (unsigned char)~sum);
+}
+
+static void loadRecord(unsigned long addr, const unsigned char *data, int length, void *context)
+// distest.s19 goes into memory for dis and dm, and into the lf text moved up to LF_BASE
+{
+    int i;
+
+    for(i = 0; i < length; i++){
+        hc11Memory[(addr + i) & 0xFFFF] = data[i];
+    }
+    if (disEnd == 0 || addr < disStart){
+        disStart = addr;
+    }
+    if (addr + length - 1 > disEnd){
+        disEnd = addr + length - 1;
+    }
+    appendRecord(addr - disStart + LF_BASE, data, length);
+}
+
+static void randomRecords(unsigned long addr, unsigned int seed)
+// Random data after distest's records, rand() with a fixed seed so each run loads the same file
+{
+    unsigned char data[RECORD_BYTES];
+    unsigned long end = addr + RANDOM_BYTES;
+    int i;
+
+    srand(seed);
+    for(; addr < end; addr += RECORD_BYTES){
+        for(i = 0; i < RECORD_BYTES; i++){
+            data[i] = rand() & 0xFF;
+        }
+        appendRecord(addr, data, RECORD_BYTES);
+    }
+    textLength += sprintf(text + textLength, "S9030000FC\n");
+}
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void monitorReset(unsigned long baud)
+// Clean SCI and timer state before each run
+{
+    SciConfig config = {baud, 1, 0, 0, SCI_SCRIPT, -1};
+
+    hc11Cycles = 0;
+    periphReset();
+    sciConfigure(&config);
+    sciInit();
+    timerInit();
+}
+
+static double timeRoutine(int routine)
+// Runs one routine once, returning the host nanoseconds it took
+{
+    char line[16];
+    double start, ns;
+    int i, reason;
+
+    if (routine == 0){
+        monitorReset(LF_BAUD);
+        sciInput((unsigned char *)text, textLength);
+    }else{
+        monitorReset(FAST_BAUD);
+    }
+    start = now();
+    if ((reason = setjmp(hc11Exit)) != 0){
+        fprintf(stderr, "monbench: routine %d stopped the simulator (%d)\n", routine, reason);
+        exit(2);
+    }
+    switch (routine) {
+        case 0:
+            lf();
+            break;
+        case 1:
+            dis(hc11Memory + disStart, hc11Memory + disEnd);
+            break;
+        case 2:
+            dm(hc11Memory + DM_START, hc11Memory + DM_START + DM_BYTES - 1, 16);
+            break;
+        default:
+            for(i = 0; i < DISPATCHES; i++){
+                strcpy(line, i & 1 ? "bc 7000" : "bp 7000");    // handleCommand() splits the line in place
+                handleCommand(commands, line);
+            }
+    }
+    ns = now() - start;
+    mflush();   // Send what is left in the transmit ring outside the timing
+    return ns;
+}
+
+static int compare(const char *path, Result *results, double threshold)
+// Returns 1 if any routine is more than threshold percent slower than the baseline
+{
+    FILE *file = fopen(path, "r");
+    char name[32];
+    double ns, change;
+    int i, failed = 0;
+
+    if (file == NULL){
+        printf("No baseline at %s, make bench-baseline to save one\n", path);
+        return 0;
+    }
+    while(fscanf(file, "%31s %lf", name, &ns) == 2){
+        for(i = 0; i < ROUTINES; i++){
+            if (strcmp(name, results[i].name) == 0){
+                change = (results[i].ns - ns) * 100 / ns;
+                printf("%-10s %+7.1f%%  (baseline %.1f)%s\n", name, change, ns,
+                        change > threshold ? "  REGRESSION" : "");
+                failed |= change > threshold;
+            }
+        }
+    }
+    fclose(file);
+    return failed;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "Usage: monbench [-n runs] [-t percent] [-u] [-r seed] distest.s19 [baseline]\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    Result results[ROUTINES] = {{"lf", "ns/KB"}, {"dis", "ns/instr"}, {"dm", "ns/byte"}, {"dispatch", "ns/command"}};
+    double units[ROUTINES], ns, threshold = 10;
+    int runs = 5, update = 0, option, i, run;
+    unsigned int seed = 1;
+    unsigned long pos, instructions = 0;
+    char instruction[32];
+    FILE *file;
+
+    while((option = getopt(argc, argv, "n:t:ur:")) != -1){
+        switch (option) {
+            case 'n': runs = atoi(optarg); break;
+            case 't': threshold = atof(optarg); break;
+            case 'u': update = 1; break;
+            case 'r': seed = strtoul(optarg, NULL, 0); break;
+            default: usage();
+        }
+    }
+    if (optind >= argc || optind + 2 < argc || runs < 1){
+        usage();
+    }
+
+    hc11Reset();
+    if (srecRead(argv[optind], loadRecord, NULL, NULL) < 0){
+        return 2;
+    }
+    randomRecords(LF_BASE + disEnd - disStart + 1, seed);
+    for(pos = disStart; pos <= disEnd; pos += decodeInstruction(hc11Memory + pos, instruction)){
+        instructions++;
+    }
+
+    units[0] = textLength / 1024.0;
+    units[1] = instructions;
+    units[2] = DM_BYTES;
+    units[3] = DISPATCHES;
+    for(run = 0; run < runs; run++){
+        for(i = 0; i < ROUTINES; i++){
+            ns = timeRoutine(i) / units[i];
+            if (run == 0 || ns < results[i].ns){
+                results[i].ns = ns;
+            }
+        }
+    }
+    for(i = 0; i < ROUTINES; i++){
+        printf("%-10s %12.1f %s\n", results[i].name, results[i].ns, results[i].unit);
+    }
+
+    if (optind + 1 == argc){
+        return 0;
+    }
+    if (update){
+        if ((file = fopen(argv[optind + 1], "w")) == NULL){
+            perror(argv[optind + 1]);
+            return 2;
+        }
+        for(i = 0; i < ROUTINES; i++){
+            fprintf(file, "%s %.1f\n", results[i].name, results[i].ns);
+        }
+        fclose(file);
+        printf("Baseline saved to %s\n", argv[optind + 1]);
+        return 0;
+    }
+    return compare(argv[optind + 1], results, threshold);
+}
@@ -0,0 +1,379 @@
+/*Purpose: Register block model for the host simulator.
+            SCI    - Characters take 10 bit times at the configured baud rate in both directions.
+                     Received characters that arrive while RDRF is still set are lost and set OR, as on the part.
+                     The receive side is fed from a script; each line is only sent once the monitor is idle
+                     waiting for input (spinning on SCSR with nothing left to transmit). When streaming, everything
+                     after the first line is sent back to back, like a terminal program sending a file.
+                     Once the script is used up, stdin can carry on where it left off (hc11sim -i),
+                     or a pseudo terminal standing in for the board's serial port (hc11sim -p).
+            Timer  - Free running TCNT with prescaler, TOC1-TOC5 compares, overflow and RTI flags.
+            ADC    - Conversions complete 32 E-cycles per channel after ADCTL is written, results come from adcInput().
+            Anything else is a plain latch.
+*/
+
+#include <stdio.h>
+#include <unistd.h>
+#include "hc11.h"
+
+#define READY_POLLS 2     // Consecutive idle SCSR reads that mean the monitor is waiting for input
+#define LABEL_SIZE 28
+#define STDIN_LINE 256    // Longest line taken from stdin at a time
+
+static unsigned char regs[HC11_REGS];
+
+// Timer
+static unsigned int prescale;
+static unsigned char tflg1, tflg2;
+
+// ADC
+static unsigned long long adcDone;
+static unsigned char adcValue;
+
+// SCI
+static SciConfig sci;
+static unsigned long charCycles;
+static const unsigned char *input;
+static unsigned long inputLength, inputPos;
+static unsigned long long nextArrival, txDone, lineEnd;
+static int lineActive, lineTimed, streaming, rdrf, overrun, txShifting, txHolding, polls;
+static unsigned char rxData, txHold;
+static unsigned long rxBytes, txBytes, overruns;
+static char label[LABEL_SIZE + 1];
+
+void periphReset(void)
+{
+    unsigned int i;
+
+    for(i = 0; i < HC11_REGS; i++){
+        regs[i] = 0;
+    }
+    regs[R_TOC1] = regs[R_TOC2] = regs[R_TOC3] = regs[R_TOC4] = regs[R_TOC5] = 0xFF;
+    regs[R_TOC1 + 1] = regs[R_TOC2 + 1] = regs[R_TOC3 + 1] = regs[R_TOC4 + 1] = regs[R_TOC5 + 1] = 0xFF;
+    prescale = 1;
+    tflg1 = tflg2 = 0;
+    adcDone = 0;
+    lineActive = lineTimed = streaming = rdrf = overrun = txShifting = txHolding = polls = 0;
+    nextArrival = txDone = lineEnd = 0;
+    rxBytes = txBytes = overruns = 0;
+}
+
+void adcInput(unsigned char value)
+{
+    adcValue = value;
+}
+
+// ### SCI ###
+
+void sciConfigure(const SciConfig *config)
+{
+    sci = *config;
+    charCycles = (HC11_E_CLOCK * 10 + sci.baud / 2) / sci.baud;
+}
+
+unsigned long sciCharCycles(void)
+{
+    return charCycles;
+}
+
+void sciInput(const unsigned char *data, unsigned long length)
+{
+    input = data;
+    inputLength = length;
+    inputPos = 0;
+}
+
+static void transmit(unsigned char value, unsigned long long start)
+{
+    txShifting = 1;
+    txDone = start + charCycles;
+    txBytes++;
+    if (sci.input == SCI_PORT){
+        write(sci.port, &value, 1);
+    }else if (sci.echo){
+        putchar(value);
+    }
+}
+
+static void receive(void)
+{
+    unsigned char value = input[inputPos++];
+
+    rxBytes++;
+    if (rdrf){
+        overrun = 1;
+        overruns++;
+    }else{
+        rxData = value;
+        rdrf = 1;
+    }
+
+    if (inputPos >= inputLength || (!streaming && value == '\n')){
+        lineActive = 0;
+        lineEnd = nextArrival;
+        lineTimed = !streaming;
+    }else{
+        nextArrival += charCycles;
+    }
+}
+
+static int sciStdin(void)
+/* Purpose: The script is used up, waits on stdin for the next line (SCI_LINES) or key (SCI_KEYS) and makes it
+            the input. Returns 0 at the end of stdin, or ^D from the terminal.
+            SCI_PORT takes whatever has arrived on the port as it is, binary included.
+Version: 1.1
+*/{
+    static unsigned char line[STDIN_LINE];
+    long length = 0;
+    int c;
+
+    if (sci.input == SCI_SCRIPT){
+        return 0;
+    }
+    fflush(stdout);
+    if (sci.input == SCI_PORT){
+        if ((length = read(sci.port, line, STDIN_LINE)) <= 0){
+            return 0;
+        }
+        sciInput(line, length);
+        return 1;
+    }
+    while(length < STDIN_LINE && (c = getchar()) != EOF){
+        if (sci.input == SCI_KEYS && c == 0x04){
+            break;
+        }
+        if (c == '\r' && sci.input == SCI_LINES){
+            continue;
+        }
+        line[length++] = c;
+        if (sci.input == SCI_KEYS || c == '\n'){
+            break;
+        }
+    }
+    if (length == 0){
+        return 0;
+    }
+    sciInput(line, length);
+    return 1;
+}
+
+static void sciReady(void)
+// The monitor is waiting for input, report the line just handled and release the next one
+{
+    unsigned long i;
+
+    if (lineActive || rdrf){
+        return;
+    }
+    if (lineTimed && sci.timing){
+        fprintf(stderr, "[hc11sim] %-*s %10llu cycles %10.3f ms\n", LABEL_SIZE, label,
+                hc11Cycles - lineEnd, (hc11Cycles - lineEnd) * 1000.0 / HC11_E_CLOCK);
+    }
+    lineTimed = 0;
+
+    if (inputPos >= inputLength && sci.input != SCI_SCRIPT && (regs[R_SCCR2] & 0x80)){
+        return;     // TIE, let the monitor send what it has queued before waiting on stdin
+    }
+    if (inputPos >= inputLength && !sciStdin()){
+        hc11Stop(HC11_STOP_INPUT);
+    }
+    for(i = 0; i < LABEL_SIZE && inputPos + i < inputLength && input[inputPos + i] != '\n'; i++){
+        label[i] = input[inputPos + i];
+    }
+    label[i] = '\0';
+    streaming = sci.stream && inputPos > 0;
+    lineActive = 1;
+    nextArrival = hc11Cycles + charCycles;
+}
+
+static unsigned char sciStatus(void)
+{
+    unsigned char status = 0;
+
+    if (!txHolding){
+        status |= 0x80; // TDRE
+        if (!txShifting){
+            status |= 0x40; // TC
+        }
+    }
+    if (rdrf){
+        status |= 0x20;
+    }
+    if (!lineActive){
+        status |= 0x10; // IDLE
+    }
+    if (overrun){
+        status |= 0x08;
+    }
+    return status;
+}
+
+void sciIdle(void)
+// The monitor is waiting on its receive buffer rather than polling SCSR
+{
+    if ((sciStatus() & 0x60) == 0x40){
+        sciReady();
+    }
+}
+
+void sciDrain(void)
+/* Purpose: Runs the clock on until the transmitter has finished sending everything written to it.
+Version: 1.0
+*/{
+    unsigned long long from;
+
+    while(txShifting){
+        from = hc11Cycles;
+        hc11Cycles = txDone;
+        periphAdvance(from, hc11Cycles);
+    }
+}
+
+void sciReport(void)
+{
+    fprintf(stderr, "[hc11sim] %-*s %10llu cycles %10.3f ms\n", LABEL_SIZE, "total",
+            hc11Cycles, hc11Cycles * 1000.0 / HC11_E_CLOCK);
+    fprintf(stderr, "[hc11sim] rx %lu bytes, tx %lu bytes, overruns %lu, %lu baud\n",
+            rxBytes, txBytes, overruns, sci.baud);
+}
+
+// ### Register access ###
+
+static unsigned int word(unsigned int reg)
+{
+    return (regs[reg] << 8) | regs[reg + 1];
+}
+
+static unsigned int tcnt(unsigned long long cycles)
+{
+    return (cycles / prescale) & 0xFFFF;
+}
+
+unsigned char periphRead(unsigned int reg)
+{
+    unsigned char status;
+
+    switch (reg) {
+        case R_TCNT:
+            return tcnt(hc11Cycles) >> 8;
+        case R_TCNT + 1:
+            return tcnt(hc11Cycles) & 0xFF;
+        case R_TFLG1:
+            return tflg1;
+        case R_TFLG2:
+            return tflg2;
+        case R_SCSR:
+            status = sciStatus();
+            if (hc11InInterrupt()){
+                return status; // sciIsr() reading it does not mean the foreground is waiting for input
+            }
+            if ((status & 0x60) == 0x40){ // Nothing received, nothing left to send
+                if (++polls >= READY_POLLS){
+                    sciReady();
+                }
+            }else{
+                polls = 0;
+            }
+            return status;
+        case R_SCDR:
+            polls = 0;
+            rdrf = overrun = 0;
+            return rxData;
+        case R_ADCTL:
+            return (hc11Cycles >= adcDone ? 0x80 : 0x00) | (regs[R_ADCTL] & 0x3F);
+        case R_ADR1: case R_ADR1 + 1: case R_ADR1 + 2: case R_ADR1 + 3:
+            return adcValue;
+    }
+    return regs[reg];
+}
+
+void periphWrite(unsigned int reg, unsigned char value)
+{
+    switch (reg) {
+        case R_TCNT: case R_TCNT + 1:
+            return; // Read only
+        case R_TFLG1:
+            tflg1 &= ~value; // Write 1 to clear
+            return;
+        case R_TFLG2:
+            tflg2 &= ~value;
+            return;
+        case R_TMSK2:
+            prescale = 1 << ((value & 3) == 0 ? 0 : (value & 3) + 1); // 1, 4, 8, 16
+            break;
+        case R_SCDR:
+            polls = 0;
+            if (!txShifting){
+                transmit(value, hc11Cycles);
+            }else{
+                txHold = value;
+                txHolding = 1;
+            }
+            return;
+        case R_ADCTL:
+            adcDone = hc11Cycles + ((value & 0x10) ? 4 : 1) * 32;
+            break;
+    }
+    regs[reg] = value;
+}
+
+void periphAdvance(unsigned long long from, unsigned long long to)
+/* Purpose: Brings the peripherals up to date for the E-clock moving from 'from' to 'to'.
+Version: 1.0
+*/{
+    unsigned long long start = from / prescale, end = to / prescale;
+    unsigned long long rti = 8192ULL << (regs[R_PACTL] & 3);
+    unsigned int i, compare;
+
+    if (end != start){
+        for(i = 0; i < 5; i++){
+            compare = word(R_TOC1 + i * 2);
+            if (end - start >= 0x10000 || ((compare - start - 1) & 0xFFFF) < end - start){
+                tflg1 |= 0x80 >> i;
+            }
+        }
+        if ((start >> 16) != (end >> 16)){
+            tflg2 |= 0x80; // TOF
+        }
+    }
+    if (from / rti != to / rti){
+        tflg2 |= 0x40; // RTIF
+    }
+
+    while(txShifting && txDone <= to){
+        if (txHolding){
+            txHolding = 0;
+            transmit(txHold, txDone);
+        }else{
+            txShifting = 0;
+        }
+    }
+    while(lineActive && nextArrival <= to){
+        receive();
+    }
+}
+
+unsigned int periphPending(void)
+/* Purpose: Returns the vector of the highest priority unmasked interrupt source, or 0 if none.
+Version: 1.0
+*/{
+    unsigned char timer = tflg1 & regs[R_TMSK1], sccr2 = regs[R_SCCR2], status;
+    unsigned int i;
+
+    if (tflg2 & regs[R_TMSK2] & 0x40){
+        return V_RTI;
+    }
+    for(i = 0; i < 5; i++){
+        if (timer & (0x80 >> i)){
+            return V_TOC1 - i * 2;
+        }
+    }
+    if (tflg2 & regs[R_TMSK2] & 0x80){
+        return V_TOF;
+    }
+    status = sciStatus();
+    if (((sccr2 & 0x80) && (status & 0x80)) || ((sccr2 & 0x40) && (status & 0x40)) ||
+        ((sccr2 & 0x20) && (status & 0x28))){
+        return V_SCI;
+    }
+    return 0;
+}
@@ -0,0 +1,168 @@
+/*Purpose: rp - reads and writes the board's memory through the monitor's rp command (host/rpclient.c),
+            at close to the line rate instead of through dm and mm. Starts rp at the monitor's prompt,
+            runs the commands in order and goes back to the prompt.
+
+Usage: rp [-b baud] device command...
+            -b  Serial port baud rate (default 9600)
+        Commands (addresses and lengths in hex):
+            read addr length            Memory as hex to stdout
+            save addr length file       Memory to file
+            write addr file             File into memory
+            fill addr length byte       length bytes of byte
+            call addr                   Call a routine, like go
+            regs                        Registers of the program stopped at a breakpoint
+        Try it without a board on hc11sim -p, which prints the pseudo terminal to use as device.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include "rpclient.h"
+
+#define MEMORY 0x10000
+
+static unsigned char buffer[MEMORY];
+
+static unsigned long hex(const char *text)
+{
+    char *end;
+    unsigned long value = strtoul(text, &end, 16);
+
+    if (*text == '\0' || *end != '\0' || value > MEMORY){
+        fprintf(stderr, "rp: %s is not a hex number up to %X\n", text, MEMORY);
+        exit(2);
+    }
+    return value;
+}
+
+static double now(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "Usage: rp [-b baud] device command...\n"
+            "    read addr length | save addr length file | write addr file | fill addr length byte | call addr | regs\n");
+    exit(2);
+}
+
+static int command(int fd, char **argv, int argc, int *used)
+// Runs the command at argv, setting used to the words it took
+{
+    unsigned long address, length, i;
+    RpRegs regs;
+    FILE *file;
+    double start = now();
+    int error, stopped;
+
+    if ((argc >= 3 && strcmp(argv[0], "read") == 0) || (argc >= 4 && strcmp(argv[0], "save") == 0)){
+        address = hex(argv[1]);
+        length = hex(argv[2]);
+        if (address + length > MEMORY){
+            usage();
+        }
+        if ((error = rpRead(fd, address, buffer, length)) != RP_OK){
+            return error;
+        }
+        if (argv[0][0] == 's'){
+            *used = 4;
+            if ((file = fopen(argv[3], "wb")) == NULL || fwrite(buffer, 1, length, file) != length){
+                perror(argv[3]);
+                exit(1);
+            }
+            fclose(file);
+        }else{
+            *used = 3;
+            for(i = 0; i < length; i++){
+                printf(i % 16 == 0 ? "%s%04lX " : "", i ? "\n" : "", address + i);
+                printf(" %02X", buffer[i]);
+            }
+            printf("\n");
+        }
+        fprintf(stderr, "rp: read %lu bytes, %.2f s\n", length, now() - start);
+        return RP_OK;
+    }
+    if (argc >= 3 && strcmp(argv[0], "write") == 0){
+        *used = 3;
+        address = hex(argv[1]);
+        if ((file = fopen(argv[2], "rb")) == NULL){
+            perror(argv[2]);
+            exit(1);
+        }
+        length = fread(buffer, 1, MEMORY - address, file);
+        fclose(file);
+        if ((error = rpWrite(fd, address, buffer, length)) != RP_OK){
+            return error;
+        }
+        fprintf(stderr, "rp: wrote %lu bytes, %.2f s\n", length, now() - start);
+        return RP_OK;
+    }
+    if (argc >= 4 && strcmp(argv[0], "fill") == 0){
+        *used = 4;
+        address = hex(argv[1]);
+        length = hex(argv[2]);
+        if (address + length > MEMORY || hex(argv[3]) > 0xFF){
+            usage();
+        }
+        memset(buffer, hex(argv[3]), length);
+        return rpWrite(fd, address, buffer, length);
+    }
+    if (argc >= 2 && strcmp(argv[0], "call") == 0){
+        *used = 2;
+        return rpCall(fd, hex(argv[1]));
+    }
+    if (strcmp(argv[0], "regs") == 0){
+        *used = 1;
+        if ((stopped = rpRegs(fd, &regs)) < 0){
+            return stopped;
+        }
+        if (stopped){
+            printf("PC %04X  SP %04X  X %04X  Y %04X  A %02X  B %02X  CCR %02X\n",
+                    regs.pc, regs.sp, regs.x, regs.y, regs.a, regs.b, regs.ccr);
+        }else{
+            printf("No program is stopped\n");
+        }
+        return RP_OK;
+    }
+    usage();
+    return RP_OK;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long baud = 9600;
+    int option, fd, error = RP_OK, used = 0;
+
+    while((option = getopt(argc, argv, "b:")) != -1){
+        switch (option) {
+            case 'b': baud = strtoul(optarg, NULL, 0); break;
+            default: usage();
+        }
+    }
+    if (optind + 2 > argc){
+        usage();
+    }
+    if ((fd = rpOpen(argv[optind], baud)) < 0){
+        perror(argv[optind]);
+        return 2;
+    }
+    if ((error = rpStart(fd)) != RP_OK){
+        fprintf(stderr, "rp: %s\n", rpError(error));
+        return 1;
+    }
+    for(optind++; optind < argc && error == RP_OK; optind += used){
+        error = command(fd, argv + optind, argc - optind, &used);
+    }
+    if (error != RP_OK){
+        fprintf(stderr, "rp: %s: %s\n", argv[optind - used], rpError(error));
+    }
+    rpQuit(fd);
+    close(fd);
+    return error != RP_OK;
+}
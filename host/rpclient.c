@@ -0,0 +1,271 @@
+/*Purpose: Client for the monitor's rp (remote protocol) command, see rpclient.h.
+            Requests longer than a frame are split into frames of up to 255 bytes, each resent on a NAK
+            or when the answer is corrupt. A call is only resent on a NAK, as the routine may already have run.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include "rpclient.h"
+
+#define SOH 0x01
+#define NAK 0x15
+#define CAN 0x18
+#define RP_FRAME 255            // Most data in one frame
+#define TIMEOUT_MS 2000         // A call waits this long for the routine to return as well
+
+static unsigned int crc16(unsigned int crc, unsigned char data)
+// Same CRC-16/CCITT as the monitor
+{
+    int i;
+
+    crc ^= (unsigned int)data << 8;
+    for(i = 0; i < 8; i++){
+        crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+    return crc & 0xFFFF;
+}
+
+static double now(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static int readByte(int fd, double until)
+// The next byte from the monitor, or -1 once until has passed
+{
+    unsigned char c;
+
+    while(now() < until){
+        if (read(fd, &c, 1) == 1){
+            return c;
+        }
+    }
+    return -1;
+}
+
+static int writeAll(int fd, const unsigned char *data, int length)
+{
+    int done;
+
+    while(length > 0){
+        if ((done = write(fd, data, length)) < 0){
+            return -1;
+        }
+        data += done;
+        length -= done;
+    }
+    return 0;
+}
+
+static speed_t baudRate(unsigned long baud)
+{
+    switch (baud) {
+        case 1200: return B1200;
+        case 2400: return B2400;
+        case 4800: return B4800;
+        case 19200: return B19200;
+        case 38400: return B38400;
+        case 57600: return B57600;
+        case 115200: return B115200;
+    }
+    return B9600;
+}
+
+int rpOpen(const char *device, unsigned long baud)
+/* Purpose: Opens the serial port to the monitor raw at baud (9600 for a rate it does not know).
+Version: 1.0
+*/{
+    struct termios tio;
+    int fd;
+
+    if ((fd = open(device, O_RDWR | O_NOCTTY)) < 0 || tcgetattr(fd, &tio) < 0){
+        return -1;
+    }
+    cfmakeraw(&tio);
+    cfsetispeed(&tio, baudRate(baud));
+    cfsetospeed(&tio, baudRate(baud));
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 1;
+    if (tcsetattr(fd, TCSANOW, &tio) < 0){
+        close(fd);
+        return -1;
+    }
+    tcflush(fd, TCIOFLUSH);
+    return fd;
+}
+
+int rpStart(int fd)
+/* Purpose: Types rp at the monitor's prompt and waits for the NAK that says it is ready for frames.
+            Its echo and header are skipped.
+Version: 1.0
+*/{
+    double until = now() + TIMEOUT_MS / 1000.0;
+    int c;
+
+    if (writeAll(fd, (const unsigned char *)"rp\r", 3) < 0){
+        return RP_TIMEOUT;
+    }
+    while((c = readByte(fd, until)) != NAK){
+        if (c < 0){
+            return RP_TIMEOUT;
+        }
+    }
+    return RP_OK;
+}
+
+static int request(int fd, int opcode, unsigned int address, const unsigned char *payload, int length,
+        unsigned char *answer, int *answerLength, unsigned int *answerAddress)
+/* Purpose: Sends one frame and reads the answer, sending it again after a NAK, a timeout or a corrupt answer.
+            A call ('X') is only sent again after a NAK, which the monitor sends before acting on a frame. After a
+            timeout or a corrupt answer the routine may have run (or still be running), so that is returned instead.
+            length is the payload for RP_WRITE and the bytes wanted for the others.
+Version: 1.1
+*/{
+    unsigned char frame[5 + RP_FRAME + 2], header[4];
+    unsigned int crc = 0xFFFF;
+    int size = 0, i, c, tries, got;
+    double until;
+
+    frame[size++] = SOH;
+    frame[size++] = opcode;
+    frame[size++] = address >> 8;
+    frame[size++] = address & 0xFF;
+    frame[size++] = length;
+    if (opcode == 'W'){
+        memcpy(frame + size, payload, length);
+        size += length;
+    }
+    for(i = 1; i < size; i++){
+        crc = crc16(crc, frame[i]);
+    }
+    frame[size++] = crc >> 8;
+    frame[size++] = crc & 0xFF;
+
+    for(tries = 0; tries <= RP_RETRIES; tries++){
+        if (writeAll(fd, frame, size) < 0){
+            return RP_TIMEOUT;
+        }
+        until = now() + TIMEOUT_MS / 1000.0;
+        while((c = readByte(fd, until)) >= 0 && c != SOH && c != NAK && c != CAN);
+        if (c == CAN){
+            return RP_REFUSED;
+        }
+        if (c != SOH && (c == NAK || opcode != 'X')){
+            continue;   // NAK or nothing, send it again
+        }
+        if (c != SOH){
+            return RP_TIMEOUT;
+        }
+
+        crc = 0xFFFF;
+        for(i = 0; i < 4 && (c = readByte(fd, until)) >= 0; i++){
+            header[i] = c;
+            crc = crc16(crc, c);
+        }
+        for(got = 0; c >= 0 && got < header[3] + 2; got++){
+            if ((c = readByte(fd, until)) >= 0){
+                if (got < header[3] && answer != NULL){
+                    answer[got] = c;
+                }
+                crc = crc16(crc, c);
+            }
+        }
+        if (c < 0 || crc != 0 || header[0] != opcode){
+            tcflush(fd, TCIFLUSH);
+            if (opcode == 'X'){
+                return c < 0 ? RP_TIMEOUT : RP_CORRUPT;
+            }
+            continue;
+        }
+        if (answerLength != NULL){
+            *answerLength = header[3];
+        }
+        if (answerAddress != NULL){
+            *answerAddress = (header[1] << 8) | header[2];
+        }
+        return RP_OK;
+    }
+    return c < 0 ? RP_TIMEOUT : RP_CORRUPT;
+}
+
+int rpRead(int fd, unsigned int address, unsigned char *data, unsigned long length)
+{
+    int part, got, error;
+
+    for(; length > 0; length -= part, address += part, data += part){
+        part = length > RP_FRAME ? RP_FRAME : length;
+        if ((error = request(fd, 'R', address, NULL, part, data, &got, NULL)) != RP_OK){
+            return error;
+        }
+        if (got != part){
+            return RP_CORRUPT;
+        }
+    }
+    return RP_OK;
+}
+
+int rpWrite(int fd, unsigned int address, const unsigned char *data, unsigned long length)
+{
+    int part, error;
+
+    for(; length > 0; length -= part, address += part, data += part){
+        part = length > RP_FRAME ? RP_FRAME : length;
+        if ((error = request(fd, 'W', address, data, part, NULL, NULL, NULL)) != RP_OK){
+            return error;
+        }
+    }
+    return RP_OK;
+}
+
+int rpCall(int fd, unsigned int address)
+{
+    return request(fd, 'X', address, NULL, 0, NULL, NULL, NULL);
+}
+
+int rpRegs(int fd, RpRegs *regs)
+/* Purpose: Gets the registers of the program stopped at a breakpoint, from the frame the SWI stacked
+            (CCR, B, A, X, Y, PC). Returns 1 with regs filled in, 0 if no program is stopped, or an error.
+Version: 1.0
+*/{
+    unsigned char frame[RP_FRAME];
+    unsigned int address;
+    int length, error;
+
+    if ((error = request(fd, 'G', 0, NULL, 0, frame, &length, &address)) != RP_OK){
+        return error;
+    }
+    if (length < 9){
+        return 0;
+    }
+    regs->ccr = frame[0];
+    regs->b = frame[1];
+    regs->a = frame[2];
+    regs->x = (frame[3] << 8) | frame[4];
+    regs->y = (frame[5] << 8) | frame[6];
+    regs->pc = (frame[7] << 8) | frame[8];
+    regs->sp = address + 8;     // The SWI stacked the frame below the program's SP
+    return 1;
+}
+
+int rpQuit(int fd)
+{
+    return request(fd, 'Q', 0, NULL, 0, NULL, NULL, NULL);
+}
+
+const char *rpError(int error)
+{
+    switch (error) {
+        case RP_OK: return "ok";
+        case RP_REFUSED: return "refused by the monitor";
+        case RP_TIMEOUT: return "no answer from the monitor";
+        case RP_CORRUPT: return "answers corrupt";
+    }
+    return "unknown error";
+}
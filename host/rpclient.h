@@ -0,0 +1,31 @@
+#ifndef RPCLIENT_H
+#define RPCLIENT_H
+
+/*Purpose: Host side of the monitor's rp (remote protocol) command, for programs that read and write the board's
+            memory without going through dm and mm. See rp() in main.c for the frames.
+            rpOpen() returns the port's file descriptor (-1 if it cannot be opened) and rpRegs() returns 1 when a
+            program is stopped, otherwise every call returns RP_OK or one of the errors below.
+*/
+
+#define RP_OK        0
+#define RP_REFUSED  (-1)    // CAN, out of range or an opcode the monitor does not know
+#define RP_TIMEOUT  (-2)    // No answer, for rpCall() the routine may still be running
+#define RP_CORRUPT  (-3)    // Still corrupt after RP_RETRIES, for rpCall() after the first corrupt answer
+#define RP_RETRIES  5
+
+// Registers of a stopped program, as rpRegs() gets them
+typedef struct{
+    unsigned char ccr, a, b;
+    unsigned int x, y, sp, pc;
+}RpRegs;
+
+int rpOpen(const char *device, unsigned long baud);
+int rpStart(int fd);
+int rpRead(int fd, unsigned int address, unsigned char *data, unsigned long length);
+int rpWrite(int fd, unsigned int address, const unsigned char *data, unsigned long length);
+int rpCall(int fd, unsigned int address);
+int rpRegs(int fd, RpRegs *regs);
+int rpQuit(int fd);
+const char *rpError(int error);
+
+#endif
@@ -0,0 +1,113 @@
+/*Purpose: s19crc - works out the CRC-16/CCITT and 16 bit sum the monitor's crc command prints, from an S-record file,
+            so an image loaded with lf or lb can be checked by typing one command instead of dumping it.
+            With no range, one line is printed for each run of contiguous bytes in the file, starting with the
+            crc command to type. With a range, bytes the file does not cover count as the -f value.
+
+Usage: s19crc [-f byte] file.s19 [start end]
+            -f  Value of bytes in the range that the file does not load (default 0xFF)
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "srec.h"
+
+static unsigned char image[0x10000], loaded[0x10000];
+static unsigned int crcTable[256];
+
+static void loadRecord(unsigned long addr, const unsigned char *data, int length, void *context)
+{
+    int i;
+
+    for(i = 0; i < length; i++){
+        image[(addr + i) & 0xFFFF] = data[i];
+        loaded[(addr + i) & 0xFFFF] = 1;
+    }
+}
+
+static void crcInit(void)
+// Same CRC-16/CCITT table as the monitor
+{
+    unsigned int i, j, crc;
+
+    for(i = 0; i < 256; i++){
+        crc = i << 8;
+        for(j = 0; j < 8; j++){
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+        crcTable[i] = crc & 0xFFFF;
+    }
+}
+
+static void report(unsigned long start, unsigned long end)
+{
+    unsigned int crc = 0xFFFF, sum = 0;
+    unsigned long i;
+
+    for(i = start; i <= end; i++){
+        crc = ((crc << 8) ^ crcTable[((crc >> 8) ^ image[i]) & 0xFF]) & 0xFFFF;
+        sum += image[i];
+    }
+    printf("crc %04lX %04lX  CRC16 %04X  Sum %04X\n", start, end, crc, sum & 0xFFFF);
+}
+
+static unsigned long address(const char *text)
+{
+    char *end;
+    unsigned long value = strtoul(text, &end, 16);
+
+    if (*text == '\0' || *end != '\0' || value > 0xFFFF){
+        fprintf(stderr, "s19crc: bad address %s\n", text);
+        exit(2);
+    }
+    return value;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "Usage: s19crc [-f byte] file.s19 [start end]\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long start, end;
+    int fill = 0xFF, option, i;
+
+    while((option = getopt(argc, argv, "f:")) != -1){
+        switch (option) {
+            case 'f': fill = strtoul(optarg, NULL, 0) & 0xFF; break;
+            default: usage();
+        }
+    }
+    if (optind + 1 != argc && optind + 3 != argc){
+        usage();
+    }
+    for(i = 0; i < 0x10000; i++){
+        image[i] = fill;
+    }
+    if (srecRead(argv[optind], loadRecord, NULL, NULL) < 0){
+        return 2;
+    }
+    crcInit();
+
+    if (optind + 3 == argc){
+        start = address(argv[optind + 1]);
+        end = address(argv[optind + 2]);
+        if (end < start){
+            usage();
+        }
+        report(start, end);
+        return 0;
+    }
+
+    for(start = 0; start < 0x10000; start = end + 1){
+        if (!loaded[start]){
+            end = start;
+            continue;
+        }
+        for(end = start; end + 1 < 0x10000 && loaded[end + 1]; end++);
+        report(start, end);
+    }
+    return 0;
+}
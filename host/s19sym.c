@@ -0,0 +1,102 @@
+/*Purpose: s19sym - turns a symbol list into S4 records for the monitor, so dis shows names instead of addresses.
+            Send the output with lf after the program, the monitor keeps up to 32 symbols of 9 characters.
+            Reads the linker map from cram.BAT (map.txt), taking the lines of its symbol list
+            ("_main   000009d6   defined in ..."), or a plain list of "name address" lines (hex, $ or 0x allowed).
+            The leading underscore the compiler adds to C names is dropped.
+
+Usage: s19sym [-r start end] map.txt > symbols.s19
+            -r  Only symbols from start to end (hex), the program being debugged rather than the whole monitor
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define LINE_SIZE 256
+#define NAME_SIZE 9             // SYMBOL_NAME in main.c, less the '\0'
+#define MONITOR_SYMBOLS 32      // SYMBOLS in main.c
+
+static int address(const char *text, unsigned long *value)
+// Hex address with an optional $ or 0x, returns 0 if text is not one
+{
+    char *end;
+
+    if (*text == '$'){
+        text++;
+    }else if (text[0] == '0' && (text[1] == 'x' || text[1] == 'X')){
+        text += 2;
+    }
+    if (*text == '\0'){
+        return 0;
+    }
+    *value = strtoul(text, &end, 16);
+    return *end == '\0' && *value <= 0xFFFF;
+}
+
+static void record(unsigned long addr, const char *name)
+{
+    int length = strlen(name) > NAME_SIZE ? NAME_SIZE : strlen(name), i;
+    unsigned char sum = length + 3 + (addr >> 8) + (addr & 0xFF);
+
+    printf("S4%02X%04lX", length + 3, addr);
+    for(i = 0; i < length; i++){
+        printf("%02X", (unsigned char)name[i]);
+        sum += (unsigned char)name[i];
+    }
+    printf("%02X\n", (unsigned char)~sum);
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "Usage: s19sym [-r start end] map.txt\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    char line[LINE_SIZE], name[LINE_SIZE], value[LINE_SIZE], rest[LINE_SIZE], *symbol;
+    unsigned long start = 0, end = 0xFFFF, addr;
+    int option, fields, range = 0, count = 0;
+    FILE *file;
+
+    while((option = getopt(argc, argv, "r")) != -1){
+        switch (option) {
+            case 'r': range = 1; break;    // start and end follow as the first two arguments
+            default: usage();
+        }
+    }
+    if (range){
+        if (optind + 3 != argc || !address(argv[optind], &start) || !address(argv[optind + 1], &end) || end < start){
+            usage();
+        }
+        optind += 2;
+    }
+    if (optind + 1 != argc){
+        usage();
+    }
+    if ((file = fopen(argv[optind], "r")) == NULL){
+        perror(argv[optind]);
+        return 2;
+    }
+
+    while(fgets(line, sizeof(line), file) != NULL){
+        fields = sscanf(line, "%s %s %s", name, value, rest);
+        if (fields < 2 || (fields == 3 && strcmp(rest, "defined") != 0) || !address(value, &addr)){
+            continue;       // Not a symbol line, segment and module lines have more to them
+        }
+        if (addr < start || addr > end){
+            continue;
+        }
+        symbol = name[0] == '_' && name[1] != '\0' ? name + 1 : name;
+        record(addr, symbol);
+        count++;
+    }
+    fclose(file);
+    printf("S9030000FC\n");
+
+    if (count > MONITOR_SYMBOLS){
+        fprintf(stderr, "s19sym: %d symbols, the monitor only keeps %d, use -r\n", count, MONITOR_SYMBOLS);
+    }
+    return 0;
+}
@@ -0,0 +1,102 @@
+/*Purpose: Motorola S-record reader shared by the host tools.
+            Handles S0-S9 records, checking each checksum. Data records (S1/S2/S3) are passed to the handler.
+            S4 records (the monitor's symbols, see s19sym) are checked and skipped.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "srec.h"
+
+static int hexByte(const char *text)
+{
+    int i, value = 0, digit;
+
+    for(i = 0; i < 2; i++){
+        digit = text[i];
+        if (digit >= '0' && digit <= '9'){
+            value = (value << 4) | (digit - '0');
+        }else if (digit >= 'A' && digit <= 'F'){
+            value = (value << 4) | (digit - 'A' + 10);
+        }else if (digit >= 'a' && digit <= 'f'){
+            value = (value << 4) | (digit - 'a' + 10);
+        }else{
+            return -1;
+        }
+    }
+    return value;
+}
+
+long srecRead(const char *path, SrecHandler handler, void *context, unsigned long *entry)
+/* Purpose: Reads an S-record file, calling handler for every data record.
+            Returns the number of data bytes read, or -1 (after printing why) if the file is invalid.
+            The S7/S8/S9 start address is stored in entry when given. S4 symbol records are skipped.
+Version: 1.1
+*/{
+    FILE *file;
+    char line[600];
+    unsigned char data[256];
+    int count, addressBytes, i, value, sum;
+    unsigned long addr, lineCount = 0;
+    long total = 0;
+
+    if ((file = fopen(path, "r")) == NULL){
+        perror(path);
+        return -1;
+    }
+
+    while(fgets(line, sizeof(line), file) != NULL){
+        lineCount++;
+        if (line[0] != 'S'){
+            continue;
+        }
+        switch (line[1]) {
+            case '0': case '1': case '4': case '5': case '9': addressBytes = 2; break;
+            case '2': case '6': case '8': addressBytes = 3; break;
+            case '3': case '7': addressBytes = 4; break;
+            default:
+                fprintf(stderr, "%s:%lu: unknown record type S%c\n", path, lineCount, line[1]);
+                fclose(file);
+                return -1;
+        }
+
+        count = hexByte(line + 2);
+        if (count < addressBytes + 1 || strlen(line) < (size_t)(4 + count * 2)){
+            fprintf(stderr, "%s:%lu: bad record length\n", path, lineCount);
+            fclose(file);
+            return -1;
+        }
+
+        sum = count;
+        addr = 0;
+        for(i = 0; i < count; i++){
+            if ((value = hexByte(line + 4 + i * 2)) < 0){
+                fprintf(stderr, "%s:%lu: invalid hex digits\n", path, lineCount);
+                fclose(file);
+                return -1;
+            }
+            if (i < count - 1){
+                sum += value;
+            }
+            if (i < addressBytes){
+                addr = (addr << 8) | value;
+            }else if (i < count - 1){
+                data[i - addressBytes] = value;
+            }
+        }
+        if ((~sum & 0xFF) != value){
+            fprintf(stderr, "%s:%lu: checksum failed\n", path, lineCount);
+            fclose(file);
+            return -1;
+        }
+
+        if (line[1] >= '1' && line[1] <= '3'){
+            handler(addr, data, count - addressBytes - 1, context);
+            total += count - addressBytes - 1;
+        }else if (line[1] >= '7' && entry != NULL){
+            *entry = addr;
+        }
+    }
+
+    fclose(file);
+    return total;
+}
@@ -0,0 +1,11 @@
+#ifndef SREC_H
+#define SREC_H
+
+/*Purpose: Motorola S-record reader shared by the host tools.
+*/
+
+typedef void (*SrecHandler)(unsigned long addr, const unsigned char *data, int length, void *context);
+
+long srecRead(const char *path, SrecHandler handler, void *context, unsigned long *entry);
+
+#endif
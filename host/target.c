@@ -0,0 +1,68 @@
+/*Purpose: Host side of the platform layer main.c uses when built with -DHOST (see target.h).
+*/
+
+#include <stdarg.h>
+#include <stdio.h>
+#include "hc11.h"
+
+#define PRINTF_SIZE 1024
+
+unsigned char hostRegRead(unsigned int addr)
+{
+    hc11Advance(HC11_ACCESS);
+    return hc11Read(addr);
+}
+
+unsigned int hostRegRead16(unsigned int addr)
+{
+    hc11Advance(HC11_ACCESS);
+    return (hc11Read(addr) << 8) | hc11Read(addr + 1);
+}
+
+void hostRegWrite(unsigned int addr, unsigned char value)
+{
+    hc11Advance(HC11_ACCESS);
+    hc11Write(addr, value);
+}
+
+void hostRegWrite16(unsigned int addr, unsigned int value)
+{
+    hc11Advance(HC11_ACCESS);
+    hc11Write(addr, value >> 8);
+    hc11Write(addr + 1, value & 0xFF);
+}
+
+void hostIdle(void)
+/* Purpose: Called while the monitor spins waiting on an interrupt handler.
+            Lets the SCI model know the monitor is waiting and moves the clock on by one pass of the loop.
+Version: 1.0
+*/{
+    sciIdle();
+    hc11Advance(HC11_IDLE);
+}
+
+__attribute__((weak)) int hostPutchar(int c)
+/* Purpose: Polled SCI transmit, the same as the target library putchar.
+            Weak so that a putchar defined in main.c replaces it, as it replaces the library one on the target.
+Version: 1.0
+*/{
+    while((hostRegRead(R_SCSR) & 0x80) == 0);
+    hostRegWrite(R_SCDR, c);
+    return c;
+}
+
+int hostPrintf(const char *format, ...)
+{
+    char buffer[PRINTF_SIZE];
+    va_list args;
+    int length, i;
+
+    va_start(args, format);
+    length = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+
+    for(i = 0; i < length && i < PRINTF_SIZE - 1; i++){
+        hostPutchar((unsigned char)buffer[i]);
+    }
+    return length;
+}
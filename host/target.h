@@ -0,0 +1,48 @@
+#ifndef TARGET_H
+#define TARGET_H
+
+/*Purpose: Included through hal.h by main.c and servo.c when they are built on the host (-DHOST).
+            Maps the monitor's memory, register and console access onto the simulator in hc11.h,
+            target memory is hc11Memory and the E-clock is charged for every register access.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "hc11.h"
+
+#ifdef HOST_MAIN
+#define main HOST_MAIN      // servo.c is built with -DHOST_MAIN=servoMain
+#else
+#define main monitorMain
+#endif
+#define printf hostPrintf
+#define putchar hostPutchar
+
+#define PTR(addr) (hc11Memory + ((unsigned int)(addr) & 0xFFFF))
+#define ADDR(ptr) ((unsigned int)((unsigned char *)(ptr) - hc11Memory))
+#define REG_READ(addr) hostRegRead(addr)
+#define REG_WRITE(addr, value) hostRegWrite(addr, value)
+#define REG_WRITE16(addr, value) hostRegWrite16(addr, value)
+#define REG_READ16(addr) hostRegRead16(addr)
+#define WORD unsigned short
+#define CALL(ptr) hc11Call(ADDR(ptr))
+#define INTERRUPT
+#define ENABLE_INTERRUPTS() (hc11Cpu.ccr &= ~CCR_I)
+#define DISABLE_INTERRUPTS() (hc11Cpu.ccr |= CCR_I)
+#define SET_VECTOR(vector, handler) hc11SetNative(vector, handler)
+#define FRAME_VECTOR(vector, stub, handler) hc11SetNative(vector, handler)
+#define INTERRUPT_FRAME() ((unsigned char *)PTR(hc11InterruptFrame))
+#define IDLE() hostIdle()
+#define MONITOR_END 0       // main.c runs natively, none of it is in the simulated memory
+
+int hostPrintf(const char *format, ...);
+int hostPutchar(int c);
+unsigned char hostRegRead(unsigned int addr);
+unsigned int hostRegRead16(unsigned int addr);
+void hostRegWrite(unsigned int addr, unsigned char value);
+void hostRegWrite16(unsigned int addr, unsigned int value);
+void hostIdle(void);
+
+#endif
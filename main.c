@@ -1,17 +1,129 @@
 
 #define INPUT_SIZE 32
-#define COMMANDS 7
-#define MAX_ARGS 2
-#define MIN (char *)0x400
-#define MAX (char *)0x7DFF
+#define COMMANDS 25
+#define MAX_TOKENS (MAX_ARGS + 1)  // Command and its arguments
+#define MIN PTR(0x400)
+#define MAX PTR(0x7DFF)
 #define NULL ((void *)0)
 #define EOF (-1)
-#define STACK_SIZE 962
-#define PROGRAM_SIZE 0x5756
-#define LF_START (char *) (PROGRAM_SIZE + 500)
-#define LF_MAX (char *)(MAX - STACK_SIZE - 200)
-#define POT_MIDPOINT 1000
-#define VERSION "1.1"
+#define POT_MIDPOINT 0x6F           // ADR1 with the potentiometer central, the motor turns backwards below it
+#define RX_SIZE 64                  // SCI receive ring buffer, must be a power of 2
+#define TX_SIZE 128                 // SCI transmit ring buffer, must be a power of 2
+#define TX_TIMEOUT 20000            // Wait loops (~0.2s) before a full transmit buffer is treated as stalled
+#define RX_TIMEOUT 50000            // Wait loops (~0.5s) for the next byte of a binary frame
+#define PV_SCI 0x00C4               // Pseudo vectors, the ROM interrupt vectors jump through these (3 bytes each)
+#define PV_TOF 0x00D0
+#define PV_TOC2 0x00DC
+#define PV_RTI 0x00EB
+#define PV_SWI 0x00F4
+#define E_CLOCK 2000000UL           // TCNT counts E-clock cycles (prescaler left at 1)
+#define E_PER_US (E_CLOCK / 1000000UL)
+#define BENCH_CALLS 10              // Calls bench times when no count is given
+#define STEP_IDLE 2000              // E-clock cycles between potentiometer checks while the motor is stopped
+#define STEP_REPORT (E_CLOCK / 4)   // How often demo updates the step rate
+#define SERVO_BLOCK 0x7980          // servo.c keeps its angles here, must match servo.c
+#define SERVO_MAGIC 0x5A            // First byte of the block while servo.c is running
+#define SERVO_CHANNELS 4            // OC2-OC5
+#define SERVO_OFF 0xFF              // Angle for no pulses on a channel
+#define PROF_BLOCK 0x7990           // Profile, after the servo block, kept out of C data so it survives a reset
+#define PROF_MAGIC 0xA5             // Profile.magic once prof has run
+#define PROF_BUCKETS 64             // Histogram buckets over the profiled range
+#define PROF_RANGE 0x400            // Bytes profiled when no end is given
+#define PROF_TOP 5                  // Hottest buckets prof lists
+#define BREAKPOINTS 4               // bp slots, step has two more of its own
+#define SWI_OPCODE 0x3F             // Written over the instruction at a breakpoint
+#define SREC_SIZE 255               // Largest S record, address onwards
+#define DM_WIDTH 16                 // Default bytes per dm row, 8 or 16
+#define ROW_SIZE 96                 // Row buffer for dm and dis, enough for 16 bytes, see dumpRow()
+#define BLOCK_REPORT 16             // Differences or matches cmp and find list
+#define PATTERN_SIZE 16             // Longest find pattern in bytes
+// #define CRC_NIBBLE               // 32 byte CRC table instead of 512 bytes, crc runs at about half the speed
+#define SEGMENTS 8                  // Segments lf lists at the end of a load
+#define PREFIX_OPCODES 11            // Instructions on the 0x1A and 0xCD opcode pages
+#define DIS_ROWS 20                 // Instructions dis lists when no end is given
+#define LABELS 32                   // Branch targets dis labels in one listing
+#define SYMBOLS 32                  // Symbols lf keeps from S4 records
+#define SYMBOL_NAME 10              // Longest symbol name, with its '\0'
+
+// Command status, printed as !n after each command in batch mode
+#define STATUS_OK 0
+#define STATUS_ARGS 1               // Missing or bad arguments
+#define STATUS_FAILED 2             // The command ran and failed
+#define STATUS_UNKNOWN 3            // No such command
+
+// Remote protocol (rp) opcodes
+#define RP_READ 'R'                 // Send length bytes from address
+#define RP_WRITE 'W'                // Write the payload at address
+#define RP_CALL 'X'                 // Call address, like go
+#define RP_REGS 'G'                 // Registers of the stopped program
+#define RP_QUIT 'Q'                 // Back to the text commands
+
+// Memory map region types and what each lets the monitor do, regions.h is made from the linker map by host/mapregions
+#define MEM_IO 0                    // Register block
+#define MEM_PAGE0 1                 // Zero page variables and the pseudo vectors
+#define MEM_CODE 2                  // The monitor's code and constants
+#define MEM_DATA 3                  // The monitor's variables
+#define MEM_FREE 4                  // Free RAM for programs
+#define MEM_BLOCKS 5                // Servo and profile blocks
+#define MEM_STACK 6
+#define MEM_NONE 7                  // Not RAM
+#define MEM_LOAD 0x01               // lf and lb may load here
+#define MEM_WRITE 0x02              // mm, fill, move and rp may write here
+
+// Disassembler addressing modes, bits 0-3 mode, bits 4-6 length without any prefix byte (3 and 4 for the bit instructions),
+// bit 7 set for instructions using X that have a Y version on the 0x18 page
+#define AM_INH          0x10
+#define AM_IMM8         0x21
+#define AM_IMM16        0x32
+#define AM_DIR          0x23
+#define AM_EXT          0x34
+#define AM_IND          0x25
+#define AM_REL          0x26
+#define AM_DIR_MASK     0x37
+#define AM_IND_MASK     0x38
+#define AM_DIR_BRANCH   0x49
+#define AM_IND_BRANCH   0x4A
+#define AM_PREFIX       0x1B
+#define AM_FCB          0x1C
+#define AM_XREG         0x80
+#define AM_MODE(mode) ((mode) & 0x7F)
+#define AM_LENGTH(mode) (((mode) >> 4) & 0x07)
+#define AM_INDEXED(mode) (AM_MODE(mode) == AM_IND || AM_MODE(mode) == AM_IND_MASK || AM_MODE(mode) == AM_IND_BRANCH)
+
+// Registers an interrupt stacks, as offsets from the CCR (see INTERRUPT_FRAME()), the words high byte first
+#define FRAME_CCR 0
+#define FRAME_B 1
+#define FRAME_A 2
+#define FRAME_X 3
+#define FRAME_Y 5
+#define FRAME_PC 7
+#define FRAME_SIZE 9
+#define FRAME_WORD(frame, offset) (((unsigned int)(frame)[offset] << 8) | (frame)[(offset) + 1])
+
+// Binary load (lb) framing: SOH, address (2), length, data, CRC16 (2), or PACKED (STX) in place of SOH
+#define SOH 0x01
+#define PACKED 0x02
+#define EOT 0x04
+#define ACK 0x06
+#define NAK 0x15
+#define CAN 0x18
+
+// lf states and record results
+#define SREC_WAIT 0
+#define SREC_TYPE 1
+#define SREC_DATA 2
+#define SREC_EOL 3
+#define SREC_END 1
+#define SREC_CHECKSUM (-1)
+#define SREC_SHORT (-2)
+#define SREC_RANGE (-3)
+#define SREC_COUNT (-4)
+#define SREC_SYMBOLS (-5)
+
+#define VERSION "3.4"
+
+#include "hal.h"           // Registers, memory and interrupts, for the board or (-DHOST) the simulator
+#include "monitor.h"       // Command table, Arg, and the routines the host tools call
 
 /*Author: Haydn Gynn
 Company: Staffordshire University
@@ -25,53 +137,245 @@ Purpose: 68HC11 Monitor program
                         DIS
                         LF
                         DEMO
+                        STAT
+                        LB
+                        FILL
+                        MOVE
+                        CMP
+                        FIND
+                        CRC
+                        SERVO
+                        PROF
+                        BP
+                        BC
+                        STEP
+                        REGS
+                        BENCH
+                        SYM
+                        BATCH
+                        RP
+                        MEM
 
 Updates:
     Version     Author          Date            Purpose
     1.0         Haydn Gynn      05/12/2020      Initial Version
     1.1         Haydn Gynn      05/01/2021      Fixed bugs raised during testing
+    1.2                         17/10/2026      Interrupt driven SCI receive
+    1.3                         17/10/2026      Interrupt driven SCI transmit
+    1.4                         17/10/2026      Table driven disassembler covering the full instruction set
+    1.5                         17/10/2026      Binary load
+    1.6                         17/10/2026      S record state machine, S0-S9, segment map and load time
+    1.7                         17/10/2026      Table driven hex conversion, dm and dis rows built without printf
+    1.8                         17/10/2026      dm end address or count and row width
+    1.9                         17/10/2026      fill, move, cmp and find
+    2.0                         17/10/2026      crc, table driven CRC16
+    2.1                         17/10/2026      Command table in ROM, binary search and shortened commands
+    2.2                         17/10/2026      Single pass command line tokenizer
+    2.3                         17/10/2026      Stepper demo driven by the TOC2 interrupt, no floating point
+    2.4                         17/10/2026      servo, sets the angles of the servo.c output compare driver
+    2.5                         17/10/2026      prof, runs a program sampling its PC on the RTI
+    2.6                         17/10/2026      bp, bc, step and regs, SWI breakpoints and single stepping
+    2.7                         17/10/2026      bench, times a routine in E-clock cycles
+    2.8                         17/10/2026      dis labels branch targets and symbols loaded as S4 records, dis continues
+    2.9                         17/10/2026      lb takes packed (LZ) frames
+    3.0                         17/10/2026      Registers by name (hc11regs.h), board or simulator access chosen in hal.h, shared with servo.c
+    3.1                         17/10/2026      batch, quiet mode with a status per command, runs scripts from memory
+    3.2                         17/10/2026      rp, binary frames to read, write and call memory and read registers (host/rp)
+    3.3                         17/10/2026      Memory map from the linker map (regions.h), checked by every load and write, mem lists it
+    3.4                         17/10/2026      lf writes each record while the next is received (two staging buffers), reports rate, stalls and overruns
 */
 
 
+// One word of the command line, see tokenize()
 typedef struct{
-    int index;
-    char key[8];
-    char usage[32];
-    char description[32];
-    int (*handler)(void*, int, unsigned char**);
-    int params;
-}Command;
-
-int goHandler(Command*, int, unsigned char** args), go(unsigned char *arg);
-int helpHandler( Command*, int,  unsigned char** args), outputHelp(Command*);
-int mmHandler(Command*, int, unsigned char** args), mm(unsigned char *arg, int);
-int dmHandler(Command*, int, unsigned char** args), dm(unsigned char *arg, int);
-int disHandler(Command*, int, unsigned char** args), dis(unsigned char *start, unsigned char *end);
-int lfHandler(), lf();
-int demoHandler(), demo();
-int handleCommand(Command*, char*), clearString(char*, int), splitArgs(char*, char**),
-        validateHexArgs(Command*, char*, unsigned char**,int), strToLower(char *),
-        decodeInstruction(unsigned char *, char *),
-        mgetchar(), trim(char*, char*), addOperand(int , char *, unsigned char *, int),
-        strToHex(char *, int);
-
-char *mgets(char*, int, int), *addSuffix(int , char *, unsigned char *, int *);
+    char *text;                 // In the line, '\0' terminated
+    unsigned int value;         // Hex value, after any leading +
+    unsigned char digits;       // Number of hex digits, 0 if the word is not hex
+    unsigned char relative;     // 1 if the word started with +
+}Token;
 
+// Disassembler opcode table entry, see decodeInstruction()
+typedef struct{
+    unsigned char mnemonic;     // Index into mnemonics
+    unsigned char mode;         // AM_ addressing mode, which also holds the length
+}Opcode;
+
+typedef struct{
+    unsigned char prefix, opcode;
+    Opcode entry;
+}PrefixOpcode;
+
+typedef struct{
+    unsigned int start, length;
+}Segment;
+
+// A record decoded by lf, one is received into while the other is checked and written, see lf()
+typedef struct{
+    unsigned char type, count, sum;
+    int line;
+    unsigned char data[SREC_SIZE];  // Address, data, checksum
+}SrecBuffer;
+
+// Loaded by lf from S4 records, see srecRecord()
+typedef struct{
+    unsigned int address;
+    char name[SYMBOL_NAME];
+}Symbol;
+
+// One part of the memory map, see regionFind()
+typedef struct{
+    unsigned int start, end;    // Inclusive
+    unsigned char type;         // MEM_ type
+    unsigned char flags;        // MEM_LOAD, MEM_WRITE
+}Region;
+
+#include "regions.h"
+
+int goHandler(const Command*, int, Arg *args), go(unsigned char *arg);
+int helpHandler(const Command*, int, Arg *args), outputHelp(const Command*);
+int mmHandler(const Command*, int, Arg *args), mm(unsigned char *arg, int);
+int dmHandler(const Command*, int, Arg *args);
+int disHandler(const Command*, int, Arg *args);
+int lfHandler(const Command*, int, Arg *args);
+int demoHandler(const Command*, int, Arg *args), demo();
+int statHandler(const Command*, int, Arg *args), serialStat();
+int lbHandler(const Command*, int, Arg *args), lb();
+int fillHandler(const Command*, int, Arg *args), fill(unsigned char *, unsigned char *, unsigned char);
+int moveHandler(const Command*, int, Arg *args), move(unsigned char *, unsigned char *, unsigned char *);
+int cmpHandler(const Command*, int, Arg *args), cmp(unsigned char *, unsigned char *, unsigned char *);
+int findHandler(const Command*, int, Arg *args), find(unsigned char *, unsigned char *, char *);
+int crcHandler(const Command*, int, Arg *args), crc(unsigned char *, unsigned char *);
+int servoHandler(const Command*, int, Arg *args), servo(int, int);
+int profHandler(const Command*, int, Arg *args), prof(unsigned char *, unsigned char *);
+int bpHandler(const Command*, int, Arg *args), bp(unsigned char *);
+int bcHandler(const Command*, int, Arg *args), bc(unsigned char *);
+int stepHandler(const Command*, int, Arg *args), step();
+int benchHandler(const Command*, int, Arg *args), bench(unsigned char *, unsigned int);
+int regsHandler(const Command*, int, Arg *args), regs();
+int symHandler(const Command*, int, Arg *args), sym();
+int batchHandler(const Command*, int, Arg *args), batch(unsigned char *);
+int rpHandler(const Command*, int, Arg *args), rp();
+int memHandler(const Command*, int, Arg *args), mem();
+int findCommand(const Command*, char*), tokenize(char*, Token*),
+        validateHexArgs(const Command*, Token*, int, Arg*),
+        stepTargets(unsigned char *, unsigned char **),
+        insertBreakpoints(int, int), instructionTarget(unsigned char *, unsigned int *, unsigned int *),
+        symbolAdd(unsigned int, unsigned char *, int),
+        mgetchar(), mgetbyte(unsigned int), hexByte(char *), hexWord(char *, unsigned int *);
+
+unsigned int crc16(unsigned int, unsigned char);
+int unpack(unsigned char *, unsigned char *, int);
+int srecRecord(unsigned char *, int, int, unsigned int *, unsigned int *);
+int memoryAllows(unsigned char *, unsigned char *, unsigned char), memoryWritable(unsigned char *, unsigned char *),
+        memoryReadable(unsigned char *, unsigned char *);
+const Region *regionFind(unsigned int), *memoryLargest(unsigned char);
+unsigned long timeNow();
+int profReport();
+
+char *mgets(char*, int, int), *hexPut(char *, unsigned char), *hexPutWord(char *, unsigned int),
+        *decPut(char *, unsigned int, int), *textPut(char *, const char *), *labelPut(char *, unsigned int, int);
+
+void commandLoop(), rpReply(unsigned char *, unsigned char *, int), removeBreakpoints(), mputs(const char *), dumpRow(char *, unsigned char *, int, int),
+        disRow(char *, unsigned char *, int, int, char *);
+int mputchar(int);
+Opcode lookupInstruction(unsigned char *, unsigned int *);
+INTERRUPT void sciIsr(void), tofIsr(void), stepIsr(void), profIsr(void), swiIsr(void);
+
+// SCI receive ring buffer. sciIsr() is the only writer of rxHead and mgetchar() the only writer of rxTail,
+// both are single bytes so no locking is needed
+volatile unsigned char rxBuffer[RX_SIZE], rxHead = 0, rxTail = 0, rxHighWater = 0;
+volatile unsigned int rxOverruns = 0;
+
+// SCI transmit ring buffer, the other way round. mputchar() writes txHead, sciIsr() writes txTail
+volatile unsigned char txBuffer[TX_SIZE], txHead = 0, txTail = 0, txHighWater = 0, txStalled = 0;
+volatile unsigned int txDropped = 0;
+
+// Timer overflows (TOF) since power up, the high 16 bits of timeNow()
+volatile unsigned int tofCount = 0;
+
+// Profiler (prof), the histogram itself is a Profile at PROF_BLOCK
+typedef struct{
+    unsigned char magic;                // PROF_MAGIC
+    unsigned char shift;                // Bucket size is 1 << shift bytes
+    unsigned int start, end;            // Range profiled
+    unsigned long samples;              // All samples taken
+    unsigned int outside;               // Samples outside start-end, the monitor or other code
+    unsigned int buckets[PROF_BUCKETS]; // Samples in each bucket, stops at 0xFFFF
+}Profile;
+
+// Debugger (bp, bc, step, regs). While a program is stopped the monitor runs inside swiIsr(),
+// on top of the registers it stacked at breakFrame, until go or step sets breakResume
+typedef struct{
+    unsigned char *address;     // NULL for a free slot
+    unsigned char saved;        // Byte the SWI replaced
+    unsigned char inserted;     // 1 while the SWI is in memory
+}Breakpoint;
+
+Breakpoint breakpoints[BREAKPOINTS + 2];    // The last two are step's, for the next instruction and a branch target
+unsigned char *breakFrame = NULL;
+unsigned char breakResume = 0, breakStepOver = 0;
+
+unsigned char profStub[7], swiStub[7];  // Interrupt entry stubs built by FRAME_VECTOR on the target
+unsigned char * volatile interruptFrame;
+
+// Stepper demo, moved on a half step at a time by stepIsr()
+volatile unsigned char stepIndex = 0;
+volatile unsigned int stepCount = 0, stepLate = 0;
+
+// S record loading (lf)
+SrecBuffer srecBuffers[2];
+Segment srecSegments[SEGMENTS];
+int srecSegmentCount = 0, srecSymbols = 0;
+const unsigned char srecAddressSize[10] = {2, 2, 3, 4, 2, 2, 0, 4, 3, 2};   // Address bytes for each type, 0 = invalid
+const char *srecErrors[] = {"", "Checksum failed", "Record too short", "Address out of bounds", "S5 count does not match",
+        "Symbol table full"};
+
+// Symbols and labels for dis. disLabels only holds the branch targets of the listing being made
+Symbol symbols[SYMBOLS];
+int symbolCount = 0, disLabelCount = 0, disLine = 1;
+unsigned int disLabels[LABELS];
+unsigned char *disNext = NULL;          // Where dis on its own carries on from
+
+// Batch mode (batch), no echo or prompt and a status line after each command
+unsigned char batchMode = 0, batchRunning = 0, commandStatus = STATUS_OK;
+
+// Names of the MEM_ types for mem
+const char *memoryTypes[] = {"I/O", "Page 0", "Code", "Data", "Free", "Blocks", "Stack", "Not RAM"};
+
+// Key, Usage, Description, Handler, Params. Kept in key order for findCommand()
+const Command commands[COMMANDS] = {
+    {"batch" ,"<batch ['script addr']>"           ,"Quiet mode or run script" , batchHandler,   "a"},
+    {"bc"    ,"<bc ['addr']>"                     ,"Clear breakpoints"        , bcHandler,      "a"},
+    {"bench" ,"<bench 'addr' ['calls']>"          ,"Time a routine"           , benchHandler,   "An"},
+    {"bp"    ,"<bp ['addr']>"                     ,"Set or list breakpoints"  , bpHandler,      "a"},
+    {"cmp"   ,"<cmp 'start' 'end'|+n 'other'>"    ,"Compare memory"           , cmpHandler,     "AAA"},
+    {"crc"   ,"<crc 'start' 'end'|+n>"            ,"Checksum memory"          , crcHandler,     "AA"},
+    {"demo"  ,"<demo>"                            ,"Stepper motor program"    , demoHandler,    ""},
+    {"dis"   ,"<dis ['start' ['end'|+n]]>"        ,"Disassemble into assembly", disHandler,     "aa"},
+    {"dm"    ,"<dm 'start' ['end'|+n] [8|10]>"    ,"Display memory"           , dmHandler,      "Aan"},
+    {"fill"  ,"<fill 'start' 'end'|+n 'byte'>"    ,"Fill memory"              , fillHandler,    "AAN"},
+    {"find"  ,"<find 'start' 'end'|+n 'bytes'>"   ,"Search memory"            , findHandler,    "AAP"},
+    {"go"    ,"<go ['start addr']>"               ,"Execute or continue"      , goHandler,      "a"},
+    {"help"  ,"<help>"                            ,"Monitor help"             , helpHandler,    ""},
+    {"lb"    ,"<lb>"                              ,"Load binary frames"       , lbHandler,      ""},
+    {"lf"    ,"<lf>"                              ,"Load S19 file"            , lfHandler,      ""},
+    {"mem"   ,"<mem>"                             ,"Memory map and usage"     , memHandler,     ""},
+    {"mm"    ,"<mm 'start addr'>"                 ,"Memory modify"            , mmHandler,      "A"},
+    {"move"  ,"<move 'start' 'end'|+n 'dest'>"    ,"Copy memory"              , moveHandler,    "AAA"},
+    {"prof"  ,"<prof ['start' ['end'|+n]]>"       ,"Profile a program"        , profHandler,    "aa"},
+    {"regs"  ,"<regs>"                            ,"Stopped program registers", regsHandler,    ""},
+    {"rp"    ,"<rp>"                              ,"Remote protocol (host/rp)", rpHandler,      ""},
+    {"servo" ,"<servo ['channel' 'angle']>"       ,"Servo angle (servo.c)"    , servoHandler,   "nn"},
+    {"stat"  ,"<stat>"                            ,"Serial port statistics"   , statHandler,    ""},
+    {"step"  ,"<step>"                            ,"Run one instruction"      , stepHandler,    ""},
+    {"sym"   ,"<sym>"                             ,"List symbols"             , symHandler,     ""}};
 
 void main() {
-    char input[INPUT_SIZE];
     int c;
 
-    // Key, Usage, Description, Handler
-    Command commands[COMMANDS] = {
-            {0,"help"   ,"<help>"                           ,"Monitor help"             , helpHandler,    0},   //0
-            {1,"go"     ,"<go 'start addr'>"                ,"Execute program"          , goHandler,      1},   //1
-            {2,"mm"     ,"<mm 'start addr'>"                ,"Memory modify"            , mmHandler,      1},   //2
-            {3,"dm"     ,"<dm 'start addr'>"                ,"Display memory"           , dmHandler,      1},   //3
-            {4,"dis"    ,"<dis 'start addr' 'stop addr'>"   ,"Disassemble into assembly", disHandler,     2},   //4
-            {5,"lf"     ,"<lf>"                             ,"Load S19 file"            , lfHandler,      0},   //5
-            {6,"demo"   ,"<demo>"                           ,"Stepper motor program"    , demoHandler,    0}};  //6
-
+    sciInit();
+    timerInit();
+    FRAME_VECTOR(PV_SWI, swiStub, swiIsr);    // bp and step stop programs with SWI
 
     printf("\r\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n");
     printf("##########################################################################\n\n");
@@ -85,40 +389,101 @@ void main() {
     }
 
     do{
-        clearString(input, INPUT_SIZE);
-        printf("\nCommand :> ");
+        commandLoop();
+    }while(1);
+}
+
+void commandLoop()
+/* Purpose: Reads and runs commands, the body of main() moved here so swiIsr() can run the monitor
+            while a program is stopped. Returns when go or step lets the stopped program carry on.
+            In batch mode there is no prompt, and each command is followed by its status (!0 to !3) instead of
+            a message when it fails.
+Functions used: printf(), mgets(), handleCommand()
+Version: 1.1
+*/{
+    char input[INPUT_SIZE];
+    unsigned char quiet;
+
+    do{
+        if (!batchMode){
+            printf(breakFrame == NULL ? "\nCommand :> " : "\nBreak :> ");
+        }
         if(mgets(input,INPUT_SIZE - 1, 0) !=NULL){
-            if (!handleCommand(commands, input)){
+            quiet = batchMode;      // batch turning it off still gets its status
+            if (!handleCommand(commands, input) && !batchMode){
                 printf("\nFailed to execute command");
             }
+            if (batchMode || quiet){
+                printf("\n!%d", commandStatus);
+            }
         }
-    }while(1);
+    }while(!breakResume);
+    breakResume = 0;
 }
 
-int handleCommand(Command *commands, char *input)
-/* Author Haydn Gynn
-Company: Staffordshire University
-Created: 04/12/2020
-Purpose: Handles the parsing and execution of a command, given a string input
-Functions used: trim(), splitArgs(), strToLower(), strcmp(), validateHexArgs(), and handler command
+int batch(unsigned char *script)
+/* Purpose: Runs the commands held in memory at script, one a line, up to a 0 byte, in batch mode.
+            The script can be put there with lf (objcopy -I binary -O srec turns a text file into S records).
+            Each line is copied out before it is run, so the script is left as it was and can be run again.
+            Returns 0 if any command failed. A script cannot run batch with an address itself.
+Functions used: printf(), handleCommand()
 Version: 1.0
 */{
-    char trimmedInput[INPUT_SIZE];
-    int partsCount, i;
-    char **args;
-    unsigned char *argsList[MAX_ARGS];
+    char line[INPUT_SIZE];
+    unsigned char quiet = batchMode;
+    int length, count = 0, failed = 0;
 
-    if((partsCount = trim(input, trimmedInput)) <= 0){
+    if (batchRunning){
+        printf("\nA script cannot start another");
         return 0;
     }
-    //separate the command and args with \0, args pointer set to start of args string
-    if (partsCount > 1){
-        if(splitArgs(trimmedInput, args) == 0){
-            return 0;
+    batchRunning = batchMode = 1;
+    while(*script != '\0'){
+        for(length = 0; *script != '\0' && *script != '\n' && *script != '\r'; script++){
+            if (length < INPUT_SIZE - 1){
+                line[length++] = *script;
+            }
         }
+        while(*script == '\n' || *script == '\r'){
+            script++;
+        }
+        if (length == 0){
+            continue;
+        }
+        line[length] = '\0';
+        count++;
+        if (!handleCommand(commands, line)){
+            failed++;
+        }
+        printf("\n!%d", commandStatus);
+    }
+    batchRunning = 0;
+    batchMode = quiet;
+
+    if (!batchMode){
+        printf("\n%d commands, %d failed", count, failed);
     }
+    return failed == 0;
+}
+
+int handleCommand(const Command *commands, char *input)
+/* Author Haydn Gynn
+Company: Staffordshire University
+Created: 04/12/2020
+Modified: 17/10/2026
+Purpose: Handles the parsing and execution of a command, given a string input
+            The command can be shortened to any part of its key that no other key starts with (di for dis).
+            The line is split up in place by tokenize(), nothing is copied.
+            Why it failed is left in commandStatus for batch mode.
+Functions used: tokenize(), findCommand(), validateHexArgs(), and handler command
+Version: 2.3
+*/{
+    Token tokens[MAX_TOKENS];
+    int partsCount, i;
+    Arg argsList[MAX_ARGS];
 
-    if(strToLower(trimmedInput) == 0){
+    commandStatus = STATUS_UNKNOWN;
+    if((partsCount = tokenize(input, tokens)) == 0){
         return 0;
     }
 
@@ -126,23 +491,60 @@ Version: 1.0
     // It allows easy dropping in of commands, provided they have the correct definitions
     // Although a lot may seem like unnecessary code, especially for a monitor program that is required to be small,
     // i believe a method like this might be more maintainable and allow for future expansions
-    for(i = 0; i < COMMANDS; i++){
-        if (!strcmp(commands[i].key, trimmedInput)){
+    if ((i = findCommand(commands, tokens[0].text)) < 0){
+        return 0;
+    }
+    commandStatus = STATUS_ARGS;
+    if(!validateHexArgs(&commands[i], tokens, partsCount, argsList)){
+        return 0;
+    }
 
-            if(!validateHexArgs(&commands[i], *args, (unsigned char **)&argsList, partsCount)){
-                return 0;
-            }
+    //Execute commandHandler function found
+    if (!(*commands[i].handler)(commands, i, argsList)){
+        commandStatus = STATUS_FAILED;
+        return 0;
+    }
+    commandStatus = STATUS_OK;
+    return 1;
+}
 
-            //Execute commandHandler function found
-            return (*commands[i].handler)(commands, i, (unsigned char **)&argsList);
+int findCommand(const Command *commands, char *key)
+/* Purpose: Returns the index of the command key names, or -1 if there is none.
+            Binary search for the first command not before key, which is the only one key can be short for
+            unless the command after it also starts with key. An exact match always wins.
+            Ambiguous keys list the commands they could be.
+Functions used: strcmp(), strncmp(), strlen(), printf()
+Version: 1.0
+*/{
+    int low = 0, high = COMMANDS, middle, length = strlen(key);
+
+    while(low < high){
+        middle = (low + high) / 2;
+        if (strcmp(commands[middle].key, key) < 0){
+            low = middle + 1;
+        }else{
+            high = middle;
         }
     }
+
+    if (low == COMMANDS || strncmp(commands[low].key, key, length) != 0){
+        return -1;
+    }
+    if (commands[low].key[length] == '\0' || low + 1 == COMMANDS || strncmp(commands[low + 1].key, key, length) != 0){
+        return low;
+    }
+
+    printf("\n%s could be", key);
+    for(high = low; high < COMMANDS && strncmp(commands[high].key, key, length) == 0; high++){
+        printf(" %s", commands[high].key);
+    }
+    return -1;
 }
 
 // ### Command Handlers ###
 
 // Help
-int helpHandler(Command *commands, int index, unsigned char** args)
+int helpHandler(const Command *commands, int index, Arg *args)
 /* Author Haydn Gynn
 Company: Staffordshire University
 Created: 04/12/2020
@@ -154,19 +556,20 @@ Version: 1.0
 }
 
 // Go
-int goHandler(Command *command, int index, unsigned char** args)
+int goHandler(const Command *command, int index, Arg *args)
 /* Author Haydn Gynn
 Company: Staffordshire University
 Created: 04/12/2020
-Purpose: Handles the go command
+Modified: 17/10/2026
+Purpose: Handles the go command, go on its own continues a stopped program
 Functions used: go()
-Version: 1.0
+Version: 1.2
 */{
-    return go(args[0]);
+    return go(args[0].given ? args[0].pointer : NULL);
 }
 
 // Memory modify
-int mmHandler(Command *command, int index, unsigned char** args)
+int mmHandler(const Command *command, int index, Arg *args)
 /* Author Haydn Gynn
 Company: Staffordshire University
 Created: 04/12/2020
@@ -174,65 +577,307 @@ Purpose: Handles the modify memory command.
 Functions used: mm()
 Version: 1.0
 */{
-    return mm(args[0], 1); //InstantMode enabled for quick input
+    return mm(args[0].pointer, 1); //InstantMode enabled for quick input
 }
 
 // Display memory
-int dmHandler(Command *command, int index, unsigned char** args)
+int dmHandler(const Command *command, int index, Arg *args)
 /* Author Haydn Gynn
 Company: Staffordshire University
 Created: 04/12/2020
 Purpose: Handles the display memory command,
+            dm start [end or +count] [width], width is 8 or 10 (16 bytes), 16 rows are shown without an end.
 Functions used: dm()
-Version: 1.0
+Version: 1.3
 */{
-    return dm(args[0], 15);
+    int width = args[2].given ? args[2].value : DM_WIDTH;
+
+    if (width != 8 && width != 16){
+        printf("\nThe width must be 8 or 10 (hex)");
+        return 0;
+    }
+    if (!args[1].given){
+        args[1].pointer = (args[0].pointer + 16 * width - 1 > MAX) ? MAX : args[0].pointer + 16 * width - 1;
+    }
+    if (args[0].pointer > args[1].pointer){
+        printf("\nPlease ensure the End value is greater than the Start value.\n");
+        return 0;
+    }
+
+    return dm(args[0].pointer, args[1].pointer, width);
 }
 
 // Disassemble
-int disHandler(Command *command, int index, unsigned char** args)
+int disHandler(const Command *command, int index, Arg *args)
 /* Author Haydn Gynn
 Company: Staffordshire University
 Created: 04/12/2020
-Purpose: Handles the disAssembly command,
+Modified: 17/10/2026
+Purpose: Handles the disAssembly command, dis [start [end|+count]].
+            Without an end DIS_ROWS instructions are listed, and dis on its own carries on after the last listing.
 Functions used: dis()
-Version: 1.0
+Version: 1.2
 */{
-    if (args[0] > args[1]){
+    if (!args[0].given){
+        if (disNext == NULL){
+            printf("\nNothing to carry on from, use dis 'start'");
+            return 0;
+        }
+        return dis(disNext, NULL);
+    }
+    if (args[1].given && args[0].pointer > args[1].pointer){
         printf("\nPlease ensure the End value is greater than the Start value.\n");
         return 0;
     }
 
-    return dis(args[0], args[1]);
+    return dis(args[0].pointer, args[1].given ? args[1].pointer : NULL);
 }
 
 // Load file
-int lfHandler()
+int lfHandler(const Command *command, int index, Arg *args)
 /* Author Haydn Gynn
 Company: Staffordshire University
 Created: 04/12/2020
+Modified: 17/10/2026
 Purpose: Handle the load file command.
 Functions used: lf()
-Version: 1.0
+Version: 1.1
 */{
     return lf();
 }
 
+// Memory map
+int memHandler(const Command *command, int index, Arg *args)
+/* Purpose: Handle the mem command.
+Functions used: mem()
+Version: 1.0
+*/{
+    return mem();
+}
+
 
 // Demo
-int demoHandler()
+int demoHandler(const Command *command, int index, Arg *args)
 /* Author Haydn Gynn
 Company: Staffordshire University
 Created: 04/12/2020
+Modified: 17/10/2026
 Purpose: Handle the demo command.
-Version: 1.0
+Version: 1.1
 */{
     return demo();
 }
 
+// Binary load
+int lbHandler(const Command *command, int index, Arg *args)
+/* Purpose: Handle the binary load command.
+Functions used: lb()
+Version: 1.0
+*/{
+    return lb();
+}
+
+// Fill
+int fillHandler(const Command *command, int index, Arg *args)
+/* Purpose: Handles the fill command, fill start end|+count value
+Functions used: fill(), memoryWritable()
+Version: 1.2
+*/{
+    if (args[0].pointer > args[1].pointer || args[2].value > 0xFF){
+        printf("\nPlease ensure the End value is greater than the Start value, and the value is one byte.\n");
+        return 0;
+    }
+    if (!memoryWritable(args[0].pointer, args[1].pointer)){
+        return 0;
+    }
+    return fill(args[0].pointer, args[1].pointer, args[2].value);
+}
+
+// Move
+int moveHandler(const Command *command, int index, Arg *args)
+/* Purpose: Handles the move command, move start end|+count dest
+Functions used: move(), memoryWritable()
+Version: 1.1
+*/{
+    if (args[0].pointer > args[1].pointer || args[1].pointer - args[0].pointer > MAX - args[2].pointer){
+        printf("\nPlease ensure the End value is greater than the Start value, and the destination fits in memory.\n");
+        return 0;
+    }
+    if (!memoryWritable(args[2].pointer, args[2].pointer + (args[1].pointer - args[0].pointer))){
+        return 0;
+    }
+    return move(args[0].pointer, args[1].pointer, args[2].pointer);
+}
+
+// Compare
+int cmpHandler(const Command *command, int index, Arg *args)
+/* Purpose: Handles the compare command, cmp start end|+count other
+Functions used: cmp()
+Version: 1.0
+*/{
+    if (args[0].pointer > args[1].pointer || args[1].pointer - args[0].pointer > MAX - args[2].pointer){
+        printf("\nPlease ensure the End value is greater than the Start value, and the other block fits in memory.\n");
+        return 0;
+    }
+    return cmp(args[0].pointer, args[1].pointer, args[2].pointer);
+}
+
+// Find
+int findHandler(const Command *command, int index, Arg *args)
+/* Purpose: Handles the find command, find start end|+count pattern
+Functions used: find()
+Version: 1.0
+*/{
+    if (args[0].pointer > args[1].pointer){
+        printf("\nPlease ensure the End value is greater than the Start value.\n");
+        return 0;
+    }
+    return find(args[0].pointer, args[1].pointer, (char *)args[2].pointer);
+}
+
+// Checksum
+int crcHandler(const Command *command, int index, Arg *args)
+/* Purpose: Handles the checksum command, crc start end|+count
+Functions used: crc()
+Version: 1.0
+*/{
+    if (args[0].pointer > args[1].pointer){
+        printf("\nPlease ensure the End value is greater than the Start value.\n");
+        return 0;
+    }
+    return crc(args[0].pointer, args[1].pointer);
+}
+
+// Profile
+int profHandler(const Command *command, int index, Arg *args)
+/* Purpose: Handles the profile command, prof [start [end|+count]]. On its own it lists the last profile again.
+Functions used: prof(), profReport()
+Version: 1.1
+*/{
+    if (!args[0].given){
+        return profReport();
+    }
+    if (!args[1].given){
+        args[1].pointer = ADDR(args[0].pointer) > ADDR(MAX) - PROF_RANGE ? MAX : args[0].pointer + PROF_RANGE - 1;
+    }
+    if (args[0].pointer > args[1].pointer){
+        printf("\nPlease ensure the End value is greater than the Start value.\n");
+        return 0;
+    }
+    return prof(args[0].pointer, args[1].pointer);
+}
+
+// Servo
+int servoHandler(const Command *command, int index, Arg *args)
+/* Purpose: Handles the servo command, servo [channel angle], channel 2-5 for OC2-OC5, angle 0-B4 (0-180) or FF for off
+Functions used: servo()
+Version: 1.2
+*/{
+    if (!args[0].given){
+        return servo(0, 0);
+    }
+    if (!args[1].given || args[0].value < 2 || args[0].value > 5 || (args[1].value > 180 && args[1].value != SERVO_OFF)){
+        printf("\nPlease give a channel of 2-5 and an angle of 0-B4, or FF for off.\n");
+        return 0;
+    }
+    return servo(args[0].value, args[1].value);
+}
+
+// Benchmark
+int benchHandler(const Command *command, int index, Arg *args)
+/* Purpose: Handles the bench command, bench addr [calls], BENCH_CALLS calls when no count is given
+Functions used: bench()
+Version: 1.2
+*/{
+    if (!args[1].given){
+        return bench(args[0].pointer, BENCH_CALLS);
+    }
+    if (args[1].value == 0){
+        printf("\nPlease give at least 1 call.\n");
+        return 0;
+    }
+    return bench(args[0].pointer, args[1].value);
+}
+
+// Batch mode
+int batchHandler(const Command *command, int index, Arg *args)
+/* Purpose: Handles the batch command, batch [script addr]. On its own it turns batch mode on or off.
+Functions used: batch()
+Version: 1.1
+*/{
+    if (!args[0].given){
+        batchMode = !batchMode;
+        return 1;
+    }
+    return batch(args[0].pointer);
+}
+
+// Remote protocol
+int rpHandler(const Command *command, int index, Arg *args)
+/* Purpose: Handles the rp command.
+Functions used: rp()
+Version: 1.0
+*/{
+    return rp();
+}
+
+// Set breakpoint
+int bpHandler(const Command *command, int index, Arg *args)
+/* Purpose: Handles the bp command, bp [addr]. On its own it lists the breakpoints.
+Functions used: bp()
+Version: 1.1
+*/{
+    return bp(args[0].given ? args[0].pointer : NULL);
+}
+
+// Clear breakpoint
+int bcHandler(const Command *command, int index, Arg *args)
+/* Purpose: Handles the bc command, bc [addr]. On its own it clears every breakpoint.
+Functions used: bc()
+Version: 1.1
+*/{
+    return bc(args[0].given ? args[0].pointer : NULL);
+}
+
+// Single step
+int stepHandler(const Command *command, int index, Arg *args)
+/* Purpose: Handles the step command.
+Functions used: step()
+Version: 1.0
+*/{
+    return step();
+}
+
+// Registers
+int regsHandler(const Command *command, int index, Arg *args)
+/* Purpose: Handles the regs command.
+Functions used: regs()
+Version: 1.0
+*/{
+    return regs();
+}
+
+// Symbols
+int symHandler(const Command *command, int index, Arg *args)
+/* Purpose: Handles the sym command.
+Functions used: sym()
+Version: 1.0
+*/{
+    return sym();
+}
+
+// Serial statistics
+int statHandler(const Command *command, int index, Arg *args)
+/* Purpose: Handle the stat command.
+Functions used: serialStat()
+Version: 1.0
+*/{
+    return serialStat();
+}
+
 // ########################## Commands ####################################
 
-int outputHelp(Command *commands)
+int outputHelp(const Command *commands)
 /* Author Haydn Gynn
 Company: Staffordshire University
 Created: 04/12/2020
@@ -254,12 +899,41 @@ int go(unsigned char* args)
 /* Author Haydn Gynn
 Company: Staffordshire University
 Created: 04/12/2020
+Modified: 17/10/2026
 Purpose: Handles the go command,
-            Executes the specified place in memory
-Functions used: anonymous function
-Version: 1.0
+            Executes the specified place in memory with the breakpoints in place.
+            With no address it lets the program stopped at a breakpoint carry on. If there is a breakpoint
+            on the instruction it stopped at, that instruction is stepped over first so it is not hit again.
+Functions used: anonymous function, mflush(), printf(), stepTargets(), insertBreakpoints(), removeBreakpoints()
+Version: 1.1
 */{
-    ((unsigned char *(*)()) args)();
+    unsigned char *pc, *targets[2];
+    int i, count;
+
+    if (args == NULL){
+        if (breakFrame == NULL){
+            printf("\nNo program is stopped, use go 'start addr'");
+            return 0;
+        }
+        pc = PTR(FRAME_WORD(breakFrame, FRAME_PC));
+        for(i = 0; i < BREAKPOINTS && breakpoints[i].address != pc; i++);
+        if (i < BREAKPOINTS && (count = stepTargets(breakFrame, targets)) > 0){
+            breakpoints[BREAKPOINTS].address = targets[0];
+            breakpoints[BREAKPOINTS + 1].address = count > 1 ? targets[1] : NULL;
+            breakStepOver = insertBreakpoints(BREAKPOINTS, BREAKPOINTS + 2);
+        }
+        if (!breakStepOver){
+            insertBreakpoints(0, BREAKPOINTS);
+        }
+        breakResume = 1;
+        return 1;
+    }
+
+    mflush(); // Programs may drive the SCI themselves
+    insertBreakpoints(0, BREAKPOINTS);
+    CALL(args);
+    removeBreakpoints();
+    ENABLE_INTERRUPTS(); // In case the program masked them, output would stall
 
     return 1;
 }
@@ -268,31 +942,37 @@ int mm(unsigned char *startPos, int instantMode)
 /* Author Haydn Gynn
 Company: Staffordshire University
 Created: 04/12/2020
+Modified: 17/10/2026
 Purpose: Allows the modifying of memory, byte by byte. Terminating with '.'
             The input mode can be changed to InstantMode(1) or slowMode(0)
                 If in instantMode, it doesnt wait for carriageReturn upon entering values.
-Functions used: printf(), sscanf(), mgets()
-Version: 1.0
+            Bytes the memory map does not let it write are left as they are.
+Functions used: printf(), hexWord(), mgets(), memoryWritable()
+Version: 1.2
 */{
     char hexInput[3];
     unsigned int value;
 
     printf("Address     Hex Data\n");
     do{
-        printf("%04X      %02X    : ", startPos, *startPos);
+        printf("%04X      %02X    : ", ADDR(startPos), *startPos);
 
         if(mgets(hexInput,2,instantMode) !=NULL){
             if(hexInput[0] == '.' || hexInput[1] == '.'){
                 break;
-            }else if (sscanf(hexInput, "%2x", &value) != 1){
+            }else if (hexWord(hexInput, &value) == 0){
                 printf("\nPlease enter in <.> to terminate, <cr> to skip, <Hex data> to input\n");
                 continue;
             }
-            *startPos = value;
+            if (memoryWritable(startPos, startPos)){
+                *startPos = value;
+            }else{
+                printf("\n");
+            }
         }
         startPos++;
         if (startPos < MIN || startPos > MAX){
-            printf("\nCannot surpass maximum address (%04X)", MAX);
+            printf("\nCannot surpass maximum address (%04X)", ADDR(MAX));
             return 1;
         }
 
@@ -301,429 +981,1946 @@ Version: 1.0
     return 1;
 }
 
-int dm(unsigned char *pointer, int lineCount)
+int dm(unsigned char *pointer, unsigned char *end, int width)
 /* Author Haydn Gynn
 Company: Staffordshire University
 Created: 04/12/2020
-Purpose: Displays a specified section of memory based on the startPointer and how many lines specified, along with the equivalent ascii data
-Functions used: printf()
-Version: 1.0
+Modified: 17/10/2026
+Purpose: Displays a specified section of memory from the startPointer to the end pointer, width bytes a row,
+            along with the equivalent ascii data
+            Each row is built by dumpRow() in one buffer and sent with a single mputs().
+Functions used: printf(), dumpRow(), mputs()
+Version: 2.0
 */{
-    unsigned char *lineStart;
+    char row[ROW_SIZE];
+    int count;
+
+    // Headings over the middle of the hex and the start of the ASCII
+    printf("\nAddress%*s%*s", 3 * width / 2 + 5, "Hexdata", 3 * width / 2 + 6, "ASCII");
+
+    while(pointer <= end){
+        count = (end - pointer < width) ? end - pointer + 1 : width;
+        dumpRow(row, pointer, count, width);
+        mputs(row);
+        if (end - pointer < width){
+            break;  // Also stops pointer wrapping past the end of memory
+        }
+        pointer += count;
+    }
 
-    printf("\nAddress             Hexdata               ASCII");
+    return 1;
+}
+
+int fill(unsigned char *start, unsigned char *end, unsigned char value)
+/* Purpose: Fills memory from start to end with a byte, a word (STD) at a time.
+Version: 1.0
+*/{
+    WORD pair = (value << 8) | value;
+    unsigned int count = end - start + 1;
 
-    for(lineCount = 0; lineCount <= 15 && pointer <= MAX; lineCount++){
-        printf("\n %04X    ", pointer);
+    for(; count >= 2; count -= 2, start += 2){
+        *(WORD *)start = pair;
+    }
+    if (count){
+        *start = value;
+    }
+    return 1;
+}
 
-        //Hex Output
-        for(lineStart = pointer;pointer < lineStart + 10 && pointer <= MAX; pointer++){
-            printf("%02X ", *pointer);
+int move(unsigned char *start, unsigned char *end, unsigned char *dest)
+/* Purpose: Copies memory from start to end to dest, a word (LDD/STD) at a time.
+            Copies from the top down when dest is inside the source, so overlapping blocks move correctly.
+Version: 1.0
+*/{
+    unsigned int count = end - start + 1;
+
+    if (dest > start && dest <= end){
+        start += count;
+        dest += count;
+        for(; count >= 2; count -= 2){
+            start -= 2;
+            dest -= 2;
+            *(WORD *)dest = *(WORD *)start;
         }
-
-        //Padding
-        if (pointer != lineStart + 10){
-            printf("%*c", (10 - (pointer - lineStart)) * 3, ' ');
+        if (count){
+            *--dest = *--start;
         }
-        printf("    ");
+    }else{
+        for(; count >= 2; count -= 2, start += 2, dest += 2){
+            *(WORD *)dest = *(WORD *)start;
+        }
+        if (count){
+            *dest = *start;
+        }
+    }
+    return 1;
+}
 
-        //ASCII output
-        for(pointer = lineStart; pointer < lineStart + 10 && pointer <= MAX; pointer++){
-            if (*pointer > 127 || *pointer < 32){
-                printf(".");
-            }else{
-                printf("%c", *pointer);
+int cmp(unsigned char *start, unsigned char *end, unsigned char *other)
+/* Purpose: Compares memory from start to end with the block at other, a word at a time until they differ.
+            Lists the first BLOCK_REPORT differences and how many bytes differ in total.
+Functions used: printf()
+Version: 1.0
+*/{
+    unsigned int count = end - start + 1, differences = 0;
+
+    while(count){
+        if (count >= 2 && *(WORD *)start == *(WORD *)other){
+            count -= 2;
+            start += 2;
+            other += 2;
+            continue;
+        }
+        if (*start != *other){
+            if (differences++ < BLOCK_REPORT){
+                printf("\n %04X  %02X    %04X  %02X", ADDR(start), *start, ADDR(other), *other);
             }
         }
+        count--;
+        start++;
+        other++;
     }
 
+    if (differences > BLOCK_REPORT){
+        printf("\n ...");
+    }
+    printf("\n%u bytes differ", differences);
     return 1;
 }
 
-dis(unsigned char* start, unsigned char* end)
-/* Author Haydn Gynn
-Company: Staffordshire University
-Created: 04/12/2020
-Purpose: Disassembles machine code with a given start and end address.
-Functions used: clearString(), printf(), decodeInstruction()
+int find(unsigned char *start, unsigned char *end, char *text)
+/* Purpose: Searches memory from start to end for a pattern of hex bytes, listing the first BLOCK_REPORT matches.
+            Uses a skip table (Horspool): when the window does not match, it moves on by how far the byte
+            under the end of the window is from the end of the pattern, so most bytes are never compared.
+Functions used: hexByte(), printf()
 Version: 1.0
 */{
-    char instruction[16];
-    int iCount = 1;
+    unsigned char pattern[PATTERN_SIZE], skip[256], *last;
+    unsigned int matches = 0;
+    int length, i;
 
-    clearString(instruction, 10);
+    for(length = 0; length < PATTERN_SIZE && text[length * 2] != ' ' && text[length * 2] != '\0'; length++){
+        pattern[length] = hexByte(text + length * 2);
+    }
+    if (end - start + 1 < length){
+        printf("\nNo matches");
+        return 1;
+    }
 
-    printf("\n %04X                 %3d    ORG  $%04X",start,iCount++, start);
-    while(start <= end){
-        printf("\n %04X  ", start);
+    for(i = 0; i < 256; i++){
+        skip[i] = length;
+    }
+    for(i = 0; i < length - 1; i++){
+        skip[pattern[i]] = length - 1 - i;
+    }
 
-        start += decodeInstruction(start, instruction);
+    for(last = end - length + 1; start <= last; start += skip[start[length - 1]]){
+        for(i = length - 1; i >= 0 && start[i] == pattern[i]; i--);
+        if (i < 0 && matches++ < BLOCK_REPORT){
+            printf("\n %04X", ADDR(start));
+        }
+        if (last - start < skip[start[length - 1]]){
+            break;  // Also stops start wrapping past the end of memory
+        }
+    }
 
-        printf("%3d    %s",iCount++, instruction);
+    if (matches > BLOCK_REPORT){
+        printf("\n ...");
     }
-    printf("\n %04X                 %3d   END", start,iCount);
+    printf("\n%u matches", matches);
     return 1;
 }
 
-int decodeInstruction(unsigned char *pos, char *instruction)
-/* Author Haydn Gynn
-Company: Staffordshire University
-Created: 04/12/2020
-Purpose: Used by disHandler
-            Given a start address, the machine code will be disassembled into assembly.
-            Returning back how many bytes were consumed within the single command,
-            signaling how many bytes to jump ahead for the next command.
-Functions used: sprintf(), addSuffix(), addOperand(), printf()
+int crc(unsigned char *start, unsigned char *end)
+/* Purpose: Prints the CRC-16/CCITT and the 16 bit sum of the bytes from start to end,
+            the same values host/s19crc works out from the .s19 file, so a load can be checked without dumping it.
+Functions used: crc16(), printf()
 Version: 1.0
 */{
-    int offset = 0, before = 0, is16Bit = 0;
-    char *instructionStart = instruction;
-
-    //Prefix
-    while(instructionStart == instruction){
-        if (offset > 3) break;
-        printf("%02X ", *pos);
-        switch (*pos & 0x85) { // Apply different masks to find first part of command
-            case 0x84:
-                instruction += sprintf(instruction,"ld");
-                break;
-            case 0x85:
-                if(*pos == 0xCD){
-                    before = *pos;
-                    pos++;
-                    offset++;
-                }else{
-                    instruction += sprintf(instruction,"st");
-                }
-                break;
-            case 0x80:
-                instruction += sprintf(instruction,"sub");
-                break;
-            case 0x81:
-                if ((*pos & 0xCF) == 0x83){
-                    instruction += sprintf(instruction,"sub");
-                }else {
-                    instruction += sprintf(instruction, "ad");
-                }
-                break;
-            case 0x00:
-                before = *pos;
-                pos++;
-                offset++;
-                break;
-            default:
-                printf("%*c", (4 * 3)-(offset * 3), ' ');
-                sprintf(instruction,"        NULL");
-                return ++offset;
-        }
-    }
-    //Suffix
-    instruction = addSuffix(before, instruction, pos, &is16Bit);
-    //Padding
-    instruction += sprintf(instruction, "%*c", 5-(instruction - instructionStart), ' ');
-    //AddressingMode operand
-    offset += addOperand(before, instruction, pos, is16Bit);
-
-    //Padding
-    printf("%*c", (4 * 3)-(offset * 3), ' ');
-
-    return ++offset;
-}
+    unsigned int count = end - start + 1, value = 0xFFFF, sum = 0;
 
-char *addSuffix(int before, char * instruction, unsigned char *pos, int * is16Bit)
-/* Author Haydn Gynn
-Company: Staffordshire University
-Created: 04/12/2020
-Purpose: Used by decodeInstruction
-            Adds the suffix (CommandType / register) onto the assembly instruction
-Functions used: sprintf()
-Version: 1.0
-*/{
-    switch (*pos & 0xCF) { //Apply mask to find suffix of command
-        case 0xC3:
-            *is16Bit = 1;
-            instruction += sprintf(instruction,"dd");break;
-        case 0xCB:
-            instruction += sprintf(instruction,"db");break;
-        case 0x89:
-            instruction += sprintf(instruction,"ca");break;
-        case 0xC9:
-            instruction += sprintf(instruction,"cb");break;
-        case 0x8B:
-            instruction += sprintf(instruction,"da");break;
-        case 0xC0:
-            instruction += sprintf(instruction,"b");break;
-        case 0x80:
-            instruction += sprintf(instruction,"a");break;
-        case 0x87:case 0x86:
-            instruction += sprintf(instruction,"aa");break;
-        case 0xC7:case 0xC6:
-            instruction += sprintf(instruction,"ab");break;
-        case 0xCC:case 0xCD:case 0x83:
-            *is16Bit = 1; //Mask as that command uses a 16bit register
-            instruction += sprintf(instruction,"d");break;
-        case 0x8E:case 0x8F:
-            *is16Bit = 1;
-            instruction += sprintf(instruction,"s");break;
-        case 0xCF:case 0xCE:
-            if (before == 0 || before == 0xCD){
-                instruction += sprintf(instruction,"x");
-            }else{
-                instruction += sprintf(instruction,"y");
-            }
-            *is16Bit = 1;
-            break;
+    for(; count; count--, start++){
+        value = crc16(value, *start);
+        sum += *start;
     }
-    return instruction;
+    printf("\nCRC16 %04X  Sum %04X", value, sum & 0xFFFF);
+    return 1;
 }
 
-int addOperand(int before, char * instruction, unsigned char *pos, int is16Bit)
+// ### Disassembler tables ###
+
+// Mnemonics, each X register instruction is followed by its Y register version (see AM_XREG)
+enum{
+    ABX, ABY, CPX, CPY, DEX, DEY, INX, INY, LDX, LDY, PSHX, PSHY, PULX, PULY, STX, STY,
+    TSX, TSY, TXS, TYS, XGDX, XGDY,
+    ABA, ADCA, ADCB, ADDA, ADDB, ADDD, ANDA, ANDB, ASL, ASLA, ASLB, ASLD, ASR, ASRA, ASRB,
+    BCC, BCLR, BCS, BEQ, BGE, BGT, BHI, BITA, BITB, BLE, BLS, BLT, BMI, BNE, BPL, BRA, BRCLR,
+    BRN, BRSET, BSET, BSR, BVC, BVS, CBA, CLC, CLI, CLR, CLRA, CLRB, CLV, CMPA, CMPB, COM,
+    COMA, COMB, CPD, DAA, DEC, DECA, DECB, DES, EORA, EORB, FDIV, IDIV, INC, INCA, INCB, INS,
+    JMP, JSR, LDAA, LDAB, LDD, LDS, LSR, LSRA, LSRB, LSRD, MUL, NEG, NEGA, NEGB, NOP, ORAA,
+    ORAB, PSHA, PSHB, PULA, PULB, ROL, ROLA, ROLB, ROR, RORA, RORB, RTI, RTS, SBA, SBCA, SBCB,
+    SEC, SEI, SEV, STAA, STAB, STD, STOP, STS, SUBA, SUBB, SUBD, SWI, TAB, TAP, TBA, TEST,
+    TPA, TST, TSTA, TSTB, WAI, FCB
+};
+
+const char mnemonics[][6] = {
+    "abx", "aby", "cpx", "cpy", "dex", "dey", "inx", "iny", "ldx", "ldy", "pshx", "pshy", "pulx", "puly", "stx", "sty",
+    "tsx", "tsy", "txs", "tys", "xgdx", "xgdy",
+    "aba", "adca", "adcb", "adda", "addb", "addd", "anda", "andb", "asl", "asla", "aslb", "asld", "asr", "asra", "asrb",
+    "bcc", "bclr", "bcs", "beq", "bge", "bgt", "bhi", "bita", "bitb", "ble", "bls", "blt", "bmi", "bne", "bpl", "bra", "brclr",
+    "brn", "brset", "bset", "bsr", "bvc", "bvs", "cba", "clc", "cli", "clr", "clra", "clrb", "clv", "cmpa", "cmpb", "com",
+    "coma", "comb", "cpd", "daa", "dec", "deca", "decb", "des", "eora", "eorb", "fdiv", "idiv", "inc", "inca", "incb", "ins",
+    "jmp", "jsr", "ldaa", "ldab", "ldd", "lds", "lsr", "lsra", "lsrb", "lsrd", "mul", "neg", "nega", "negb", "nop", "oraa",
+    "orab", "psha", "pshb", "pula", "pulb", "rol", "rola", "rolb", "ror", "rora", "rorb", "rti", "rts", "sba", "sbca", "sbcb",
+    "sec", "sei", "sev", "staa", "stab", "std", "stop", "sts", "suba", "subb", "subd", "swi", "tab", "tap", "tba", "test",
+    "tpa", "tst", "tsta", "tstb", "wai", "fcb"
+};
+
+// Page 0, indexed by opcode. Indexed modes use X, the 0x18 prefix turns them into Y
+// and turns AM_XREG instructions into their Y register version (mnemonic + 1)
+const Opcode opcodes[256] = {
+/* 00 */ {TEST,AM_INH},   {NOP,AM_INH},    {IDIV,AM_INH},   {FDIV,AM_INH},   {LSRD,AM_INH},   {ASLD,AM_INH},   {TAP,AM_INH},    {TPA,AM_INH},
+/* 08 */ {INX,AM_INH|AM_XREG},{DEX,AM_INH|AM_XREG},{CLV,AM_INH},{SEV,AM_INH},{CLC,AM_INH},   {SEC,AM_INH},    {CLI,AM_INH},    {SEI,AM_INH},
+/* 10 */ {SBA,AM_INH},    {CBA,AM_INH},    {BRSET,AM_DIR_BRANCH},{BRCLR,AM_DIR_BRANCH},{BSET,AM_DIR_MASK},{BCLR,AM_DIR_MASK},{TAB,AM_INH},{TBA,AM_INH},
+/* 18 */ {FCB,AM_PREFIX}, {DAA,AM_INH},    {FCB,AM_PREFIX}, {ABA,AM_INH},    {BSET,AM_IND_MASK},{BCLR,AM_IND_MASK},{BRSET,AM_IND_BRANCH},{BRCLR,AM_IND_BRANCH},
+/* 20 */ {BRA,AM_REL},    {BRN,AM_REL},    {BHI,AM_REL},    {BLS,AM_REL},    {BCC,AM_REL},    {BCS,AM_REL},    {BNE,AM_REL},    {BEQ,AM_REL},
+/* 28 */ {BVC,AM_REL},    {BVS,AM_REL},    {BPL,AM_REL},    {BMI,AM_REL},    {BGE,AM_REL},    {BLT,AM_REL},    {BGT,AM_REL},    {BLE,AM_REL},
+/* 30 */ {TSX,AM_INH|AM_XREG},{INS,AM_INH},{PULA,AM_INH},   {PULB,AM_INH},   {DES,AM_INH},    {TXS,AM_INH|AM_XREG},{PSHA,AM_INH},{PSHB,AM_INH},
+/* 38 */ {PULX,AM_INH|AM_XREG},{RTS,AM_INH},{ABX,AM_INH|AM_XREG},{RTI,AM_INH},{PSHX,AM_INH|AM_XREG},{MUL,AM_INH},{WAI,AM_INH},{SWI,AM_INH},
+/* 40 */ {NEGA,AM_INH},   {FCB,AM_FCB},    {FCB,AM_FCB},    {COMA,AM_INH},   {LSRA,AM_INH},   {FCB,AM_FCB},    {RORA,AM_INH},   {ASRA,AM_INH},
+/* 48 */ {ASLA,AM_INH},   {ROLA,AM_INH},   {DECA,AM_INH},   {FCB,AM_FCB},    {INCA,AM_INH},   {TSTA,AM_INH},   {FCB,AM_FCB},    {CLRA,AM_INH},
+/* 50 */ {NEGB,AM_INH},   {FCB,AM_FCB},    {FCB,AM_FCB},    {COMB,AM_INH},   {LSRB,AM_INH},   {FCB,AM_FCB},    {RORB,AM_INH},   {ASRB,AM_INH},
+/* 58 */ {ASLB,AM_INH},   {ROLB,AM_INH},   {DECB,AM_INH},   {FCB,AM_FCB},    {INCB,AM_INH},   {TSTB,AM_INH},   {FCB,AM_FCB},    {CLRB,AM_INH},
+/* 60 */ {NEG,AM_IND},    {FCB,AM_FCB},    {FCB,AM_FCB},    {COM,AM_IND},    {LSR,AM_IND},    {FCB,AM_FCB},    {ROR,AM_IND},    {ASR,AM_IND},
+/* 68 */ {ASL,AM_IND},    {ROL,AM_IND},    {DEC,AM_IND},    {FCB,AM_FCB},    {INC,AM_IND},    {TST,AM_IND},    {JMP,AM_IND},    {CLR,AM_IND},
+/* 70 */ {NEG,AM_EXT},    {FCB,AM_FCB},    {FCB,AM_FCB},    {COM,AM_EXT},    {LSR,AM_EXT},    {FCB,AM_FCB},    {ROR,AM_EXT},    {ASR,AM_EXT},
+/* 78 */ {ASL,AM_EXT},    {ROL,AM_EXT},    {DEC,AM_EXT},    {FCB,AM_FCB},    {INC,AM_EXT},    {TST,AM_EXT},    {JMP,AM_EXT},    {CLR,AM_EXT},
+/* 80 */ {SUBA,AM_IMM8},  {CMPA,AM_IMM8},  {SBCA,AM_IMM8},  {SUBD,AM_IMM16}, {ANDA,AM_IMM8},  {BITA,AM_IMM8},  {LDAA,AM_IMM8},  {FCB,AM_FCB},
+/* 88 */ {EORA,AM_IMM8},  {ADCA,AM_IMM8},  {ORAA,AM_IMM8},  {ADDA,AM_IMM8},  {CPX,AM_IMM16|AM_XREG},{BSR,AM_REL},{LDS,AM_IMM16},{XGDX,AM_INH|AM_XREG},
+/* 90 */ {SUBA,AM_DIR},   {CMPA,AM_DIR},   {SBCA,AM_DIR},   {SUBD,AM_DIR},   {ANDA,AM_DIR},   {BITA,AM_DIR},   {LDAA,AM_DIR},   {STAA,AM_DIR},
+/* 98 */ {EORA,AM_DIR},   {ADCA,AM_DIR},   {ORAA,AM_DIR},   {ADDA,AM_DIR},   {CPX,AM_DIR|AM_XREG},{JSR,AM_DIR},{LDS,AM_DIR},   {STS,AM_DIR},
+/* A0 */ {SUBA,AM_IND},   {CMPA,AM_IND},   {SBCA,AM_IND},   {SUBD,AM_IND},   {ANDA,AM_IND},   {BITA,AM_IND},   {LDAA,AM_IND},   {STAA,AM_IND},
+/* A8 */ {EORA,AM_IND},   {ADCA,AM_IND},   {ORAA,AM_IND},   {ADDA,AM_IND},   {CPX,AM_IND|AM_XREG},{JSR,AM_IND},{LDS,AM_IND},   {STS,AM_IND},
+/* B0 */ {SUBA,AM_EXT},   {CMPA,AM_EXT},   {SBCA,AM_EXT},   {SUBD,AM_EXT},   {ANDA,AM_EXT},   {BITA,AM_EXT},   {LDAA,AM_EXT},   {STAA,AM_EXT},
+/* B8 */ {EORA,AM_EXT},   {ADCA,AM_EXT},   {ORAA,AM_EXT},   {ADDA,AM_EXT},   {CPX,AM_EXT|AM_XREG},{JSR,AM_EXT},{LDS,AM_EXT},   {STS,AM_EXT},
+/* C0 */ {SUBB,AM_IMM8},  {CMPB,AM_IMM8},  {SBCB,AM_IMM8},  {ADDD,AM_IMM16}, {ANDB,AM_IMM8},  {BITB,AM_IMM8},  {LDAB,AM_IMM8},  {FCB,AM_FCB},
+/* C8 */ {EORB,AM_IMM8},  {ADCB,AM_IMM8},  {ORAB,AM_IMM8},  {ADDB,AM_IMM8},  {LDD,AM_IMM16},  {FCB,AM_PREFIX}, {LDX,AM_IMM16|AM_XREG},{STOP,AM_INH},
+/* D0 */ {SUBB,AM_DIR},   {CMPB,AM_DIR},   {SBCB,AM_DIR},   {ADDD,AM_DIR},   {ANDB,AM_DIR},   {BITB,AM_DIR},   {LDAB,AM_DIR},   {STAB,AM_DIR},
+/* D8 */ {EORB,AM_DIR},   {ADCB,AM_DIR},   {ORAB,AM_DIR},   {ADDB,AM_DIR},   {LDD,AM_DIR},    {STD,AM_DIR},    {LDX,AM_DIR|AM_XREG},{STX,AM_DIR|AM_XREG},
+/* E0 */ {SUBB,AM_IND},   {CMPB,AM_IND},   {SBCB,AM_IND},   {ADDD,AM_IND},   {ANDB,AM_IND},   {BITB,AM_IND},   {LDAB,AM_IND},   {STAB,AM_IND},
+/* E8 */ {EORB,AM_IND},   {ADCB,AM_IND},   {ORAB,AM_IND},   {ADDB,AM_IND},   {LDD,AM_IND},    {STD,AM_IND},    {LDX,AM_IND|AM_XREG},{STX,AM_IND|AM_XREG},
+/* F0 */ {SUBB,AM_EXT},   {CMPB,AM_EXT},   {SBCB,AM_EXT},   {ADDD,AM_EXT},   {ANDB,AM_EXT},   {BITB,AM_EXT},   {LDAB,AM_EXT},   {STAB,AM_EXT},
+/* F8 */ {EORB,AM_EXT},   {ADCB,AM_EXT},   {ORAB,AM_EXT},   {ADDB,AM_EXT},   {LDD,AM_EXT},    {STD,AM_EXT},    {LDX,AM_EXT|AM_XREG},{STX,AM_EXT|AM_XREG}
+};
+
+// The 0x1A and 0xCD pages only hold a few instructions, indexed modes use X after 0x1A and Y after 0xCD
+const PrefixOpcode prefixOpcodes[PREFIX_OPCODES] = {
+    {0x1A,0x83,{CPD,AM_IMM16}}, {0x1A,0x93,{CPD,AM_DIR}}, {0x1A,0xA3,{CPD,AM_IND}}, {0x1A,0xB3,{CPD,AM_EXT}},
+    {0x1A,0xAC,{CPY,AM_IND}},   {0x1A,0xEE,{LDY,AM_IND}}, {0x1A,0xEF,{STY,AM_IND}},
+    {0xCD,0xA3,{CPD,AM_IND}},   {0xCD,0xAC,{CPX,AM_IND}}, {0xCD,0xEE,{LDX,AM_IND}}, {0xCD,0xEF,{STX,AM_IND}}
+};
+
+int dis(unsigned char* start, unsigned char* end)
 /* Author Haydn Gynn
 Company: Staffordshire University
 Created: 04/12/2020
-Purpose: Used by decodeInstruction
-            Adds the operand (Value) onto the assembly instruction
-            Figures out how to display the numerical part of the command
-Functions used: sprintf()
-Version: 1.0
+Modified: 17/10/2026
+Purpose: Disassembles machine code with a given start and end address, or DIS_ROWS instructions if end is NULL.
+            Two passes first collect the branch and jump targets that start an instruction in the listing
+            into disLabels, so they are shown as labels (L4010), as are loaded symbols. Each label gets a row of its own above its instruction.
+            Starting where the last listing stopped carries on with its line numbers, without ORG,
+            so a long listing can be read a screen at a time without sending anything twice.
+            Each row is built by disRow() and sent in one go.
+Functions used: printf(), instructionTarget(), decodeInstruction(), labelPut(), disRow(), mputs()
+Version: 3.0
 */{
-    int mask, offset = 0;
-    mask = *pos & 0x30;
-    if(mask == 0x00){ // IMM mode
-        instruction += sprintf(instruction, "#");
-        if(is16Bit == 1 && *(pos+1) == 0){ //If data is 0010 only show as 10 (skips over byte)
-            printf("%02X ", *(pos + 1));
-            offset++;
-            pos++;
-            is16Bit = 0;
+    char instruction[32], row[ROW_SIZE], *label, *out;
+    unsigned char *pos, *last;
+    unsigned int length, target;
+    int rows, i, j;
+
+    //First pass, the end of the listing and the branch and jump targets from its start on
+    disLabelCount = 0;
+    for(pos = start, rows = 0; end != NULL ? pos <= end : rows < DIS_ROWS; pos += length, rows++){
+        if (instructionTarget(pos, &length, &target) && target >= ADDR(start)){
+            for(i = 0; i < disLabelCount && disLabels[i] != target; i++);
+            if (i == disLabelCount && disLabelCount < LABELS){
+                disLabels[disLabelCount++] = target;
+            }
         }
     }
-    instruction += sprintf(instruction, "$%02X", *(pos + 1));
-    printf("%02X ", *(pos + 1));
-    if(mask == 0x20){
-        if (before == 0 || before == 0x1A){ //IND X
-            instruction += sprintf(instruction, ",X");
-        } else if(before == 0x18 || before == 0xCD){ //IND Y
-            instruction += sprintf(instruction, ",Y");
+    //Second pass, keep the targets that are the start of an instruction in the listing
+    for(last = pos, pos = start, j = 0; pos < last; pos += length){
+        instructionTarget(pos, &length, &target);
+        for(i = j; i < disLabelCount && disLabels[i] != ADDR(pos); i++);
+        if (i < disLabelCount){
+            disLabels[i] = disLabels[j];
+            disLabels[j++] = ADDR(pos);
         }
-    }else if((is16Bit == 1 && mask == 0x00) || mask == 0x30){ //2 BYTE data (EXT and REG D, S, LDX, LDY)
-        instruction += sprintf(instruction, "%02X", *(pos + 2));
-        printf("%02X ", *(pos + 2));
-        offset++;
     }
-    return ++offset;
-}
+    disLabelCount = j;
 
-int lf()
-/* Author Haydn Gynn
+    if (start != disNext){
+        disLine = 1;
+        printf("\n %04X                 %3d    ORG  $%04X",ADDR(start),disLine++, ADDR(start));
+    }
+    for(rows = 0; end != NULL ? start <= end : rows < DIS_ROWS; rows++){
+        label = textPut(hexPutWord(textPut(row, "\n "), ADDR(start)), "                        ");
+        if ((out = labelPut(label, ADDR(start), 0)) != label){
+            *textPut(out, ":") = '\0';
+            mputs(row);
+        }
+        length = decodeInstruction(start, instruction);
+        disRow(row, start, length, disLine++, instruction);
+        mputs(row);
+        start += length;
+    }
+    if (end != NULL){
+        printf("\n %04X                 %3d    END", ADDR(start),disLine);
+    }
+    disNext = start;
+    disLabelCount = 0;      // Other listings (prof, regs) only show symbols
+    return 1;
+}
+
+Opcode lookupInstruction(unsigned char *pos, unsigned int *prefix)
+/* Purpose: Looks up the instruction at pos in the opcodes table (or prefixOpcodes after 0x1A/0xCD),
+            giving its mnemonic and addressing mode. prefix is set to the prefix byte, 0 for none.
+            Bytes that are not an instruction come back as FCB with mode AM_FCB.
+            Split out of decodeInstruction() for step.
+Version: 1.0
+*/{
+    Opcode entry = opcodes[*pos];
+    unsigned int i;
+
+    *prefix = 0;
+    if (AM_MODE(entry.mode) == AM_PREFIX){
+        *prefix = *pos;
+        if (*prefix == 0x18){
+            entry = opcodes[pos[1]];
+            if (entry.mode & AM_XREG){
+                entry.mnemonic++;
+            }else if (!AM_INDEXED(entry.mode)){
+                entry.mode = AM_FCB;
+            }
+        }else{
+            entry.mode = AM_FCB;
+            for(i = 0; i < PREFIX_OPCODES; i++){
+                if (prefixOpcodes[i].prefix == *prefix && prefixOpcodes[i].opcode == pos[1]){
+                    entry = prefixOpcodes[i].entry;
+                    break;
+                }
+            }
+        }
+        if (AM_MODE(entry.mode) == AM_FCB || AM_MODE(entry.mode) == AM_PREFIX){
+            entry.mode = AM_FCB;    // Show the prefix on its own
+            *prefix = 0;
+        }
+    }
+    if (AM_MODE(entry.mode) == AM_FCB){
+        entry.mnemonic = FCB;
+    }
+    return entry;
+}
+
+int decodeInstruction(unsigned char *pos, char *instruction)
+/* Author Haydn Gynn
 Company: Staffordshire University
 Created: 04/12/2020
+Modified: 17/10/2026
+Purpose: Used by dis
+            Given a start address, the machine code will be disassembled into assembly.
+            Returning back how many bytes were consumed within the single command,
+            signaling how many bytes to jump ahead for the next command.
+            lookupInstruction() gives the mnemonic and the addressing mode, and so the length and operand format.
+            Extended addresses and branch targets are shown by labelPut(), as a symbol or label if there is one.
+            Bytes that are not an instruction are shown as fcb.
+Functions used: lookupInstruction(), textPut(), hexPut(), hexPutWord(), labelPut()
+Version: 2.3
+*/{
+    unsigned int prefix, length;
+    Opcode entry = lookupInstruction(pos, &prefix);
+    char *index = "", *out;
+
+    if (AM_INDEXED(entry.mode)){
+        index = (prefix == 0x18 || prefix == 0xCD) ? ",Y" : ",X";
+    }
+
+    length = AM_LENGTH(entry.mode) + (prefix != 0);
+    pos += length - AM_LENGTH(entry.mode);  // Skip the prefix
+
+    //Mnemonic, padded to 6 characters when there is an operand
+    out = textPut(instruction, mnemonics[entry.mnemonic]);
+    if (AM_MODE(entry.mode) != AM_INH){
+        while(out < instruction + 6){
+            *out++ = ' ';
+        }
+    }
+
+    switch (AM_MODE(entry.mode)) {
+        case AM_INH:
+            break;
+        case AM_IMM8:
+            out = hexPut(textPut(out, "#$"), pos[1]);
+            break;
+        case AM_IMM16:
+            out = hexPut(hexPut(textPut(out, "#$"), pos[1]), pos[2]);
+            break;
+        case AM_EXT:
+            out = labelPut(out, (pos[1] << 8) | pos[2], 1);
+            break;
+        case AM_REL:
+            out = labelPut(out, ADDR(pos) + 2 + (signed char)pos[1], 1);
+            break;
+        case AM_FCB:
+            out = hexPut(textPut(out, "$"), pos[0]);
+            break;
+        default:    // Direct or indexed, then the mask and branch target of the bit instructions
+            out = textPut(hexPut(textPut(out, "$"), pos[1]), index);
+            if (AM_LENGTH(entry.mode) >= 3){
+                out = hexPut(textPut(out, ",#$"), pos[2]);
+            }
+            if (AM_LENGTH(entry.mode) == 4){
+                out = labelPut(textPut(out, ","), ADDR(pos) + 4 + (signed char)pos[3], 1);
+            }
+    }
+    *out = '\0';
+
+    return length;
+}
+
+int instructionTarget(unsigned char *pos, unsigned int *length, unsigned int *target)
+/* Purpose: Used by dis to find the places to label. Sets length to the length of the instruction at pos and,
+            for a branch (including brset/brclr and bsr) or an extended jmp/jsr, target to where it goes.
+            Returns 1 if there is a target.
+Functions used: lookupInstruction()
+Version: 1.0
+*/{
+    unsigned int prefix;
+    Opcode entry = lookupInstruction(pos, &prefix);
+
+    *length = AM_LENGTH(entry.mode) + (prefix != 0);
+    pos += prefix != 0;
+    switch (AM_MODE(entry.mode)) {
+        case AM_REL:
+            *target = ADDR(pos) + 2 + (signed char)pos[1];
+            return 1;
+        case AM_DIR_BRANCH:
+        case AM_IND_BRANCH:
+            *target = ADDR(pos) + 4 + (signed char)pos[3];
+            return 1;
+        case AM_EXT:
+            *target = (pos[1] << 8) | pos[2];
+            return entry.mnemonic == JMP || entry.mnemonic == JSR;
+    }
+    return 0;
+}
+
+int sym()
+/* Purpose: Lists the symbols loaded by lf from S4 records (see host/s19sym).
+Functions used: printf()
+Version: 1.0
+*/{
+    int i;
+
+    if (symbolCount == 0){
+        printf("\nNo symbols, load them with lf (build/s19sym makes them from map.txt)");
+        return 1;
+    }
+    for(i = 0; i < symbolCount; i++){
+        printf("\n%04X  %s", symbols[i].address, symbols[i].name);
+    }
+    return 1;
+}
+
+int symbolAdd(unsigned int address, unsigned char *name, int length)
+/* Purpose: Used by lf for an S4 record, adds the symbol name (length characters, cut to fit) at address,
+            or renames the symbol already there. Returns 0 or SREC_SYMBOLS if the table is full.
+Version: 1.0
+*/{
+    Symbol *symbol;
+    int i;
+
+    for(i = 0; i < symbolCount && symbols[i].address != address; i++);
+    if (i == SYMBOLS){
+        return SREC_SYMBOLS;
+    }
+    if (i == symbolCount){
+        symbolCount++;
+    }
+    symbol = &symbols[i];
+    symbol->address = address;
+    if (length > SYMBOL_NAME - 1){
+        length = SYMBOL_NAME - 1;
+    }
+    for(i = 0; i < length; i++){
+        symbol->name[i] = name[i];
+    }
+    symbol->name[length] = '\0';
+    return 0;
+}
+
+const Region *regionFind(unsigned int address)
+/* Purpose: Finds the region holding address by a binary search of regions, which are sorted and cover all 64K.
+Version: 1.0
+*/{
+    int low = 0, high = REGIONS - 1, middle;
+
+    while(low < high){
+        middle = (low + high + 1) / 2;
+        if (regions[middle].start <= address){
+            low = middle;
+        }else{
+            high = middle - 1;
+        }
+    }
+    return &regions[low];
+}
+
+int memoryAllows(unsigned char *start, unsigned char *end, unsigned char flags)
+/* Purpose: Returns 1 if all of start -> end lies in one region with flags (MEM_LOAD, MEM_WRITE).
+            mapregions joins neighbouring regions of the same type, so one lookup covers any range that is allowed.
+            Nothing below MONITOR_END (the linker's end of .bss) is allowed either, so a regions.h older than
+            the monitor it was built into can refuse loads but never let one overwrite the monitor.
+Functions used: regionFind()
+Version: 1.0
+*/{
+    const Region *region = regionFind(ADDR(start));
+
+    return start <= end && ADDR(start) >= MONITOR_END && (region->flags & flags) == flags && ADDR(end) <= region->end;
+}
+
+int memoryWritable(unsigned char *start, unsigned char *end)
+/* Purpose: Used by mm, fill, move and bp, memoryAllows() for MEM_WRITE, saying which region (or the monitor itself)
+            is in the way when not.
+Functions used: memoryAllows(), regionFind(), printf()
+Version: 1.0
+*/{
+    const Region *region;
+
+    if (memoryAllows(start, end, MEM_WRITE)){
+        return 1;
+    }
+    if (ADDR(start) < MONITOR_END){
+        printf("\n%04X -> %04X is protected (the monitor ends at %04X)", ADDR(start), ADDR(end), MONITOR_END);
+        return 0;
+    }
+    region = regionFind(ADDR(start));
+    if (region->flags & MEM_WRITE){
+        region = regionFind(region->end + 1);
+    }
+    printf("\n%04X -> %04X is protected (%s %04X -> %04X)", ADDR(start), ADDR(end),
+            memoryTypes[region->type], region->start, region->end);
+    return 0;
+}
+
+int memoryReadable(unsigned char *start, unsigned char *end)
+/* Purpose: Used by rp, returns 1 if no part of start -> end is in the register block, where reading
+            SCSR then SCDR would take a received character from under the SCI interrupt.
+Functions used: regionFind()
+Version: 1.0
+*/{
+    const Region *region = regionFind(ADDR(start));
+
+    if (end < start){
+        return 0;
+    }
+    for(; region < regions + REGIONS && region->start <= ADDR(end); region++){
+        if (region->type == MEM_IO){
+            return 0;
+        }
+    }
+    return 1;
+}
+
+const Region *memoryLargest(unsigned char flags)
+/* Purpose: The largest region with flags, the range lf and lb offer for a download, NULL if there is none
+            (regions.h made without a map).
+Version: 1.0
+*/{
+    const Region *largest = NULL;
+    int i;
+
+    for(i = 0; i < REGIONS; i++){
+        if ((regions[i].flags & flags) == flags &&
+                (largest == NULL || regions[i].end - regions[i].start > largest->end - largest->start)){
+            largest = &regions[i];
+        }
+    }
+    return largest;
+}
+
+int mem()
+/* Purpose: Lists the memory map, each region with its size and what may be done there,
+            then how much the monitor uses and how much RAM is free for programs.
+            Says so if regions.h was made without a map, or from an older link than this monitor.
+Functions used: printf(), memoryLargest()
+Version: 1.0
+*/{
+    const Region *region;
+    unsigned long size, code = 0, data = 0, free = 0;
+    int i;
+
+    printf("\nStart  End    Bytes  Type     Access");
+    for(i = 0, region = regions; i < REGIONS; i++, region++){
+        size = (unsigned long)region->end - region->start + 1;
+        printf("\n%04X   %04X  %6lu  %-8s %s", region->start, region->end, size, memoryTypes[region->type],
+                (region->flags & MEM_LOAD) ? "load, write" : (region->flags & MEM_WRITE) ? "write" : "-");
+        if (region->type == MEM_CODE){
+            code += size;
+        }else if (region->type == MEM_DATA){
+            data += size;
+        }else if (region->type == MEM_FREE){
+            free += size;
+        }
+    }
+    printf("\n\nMonitor code %lu bytes, data %lu bytes, free RAM %lu bytes", code, data, free);
+    region = memoryLargest(MEM_LOAD);
+    if (region == NULL || region->start < MONITOR_END){
+        printf("\nregions.h does not match this build (the monitor ends at %04X), rebuild with cram.BAT", MONITOR_END);
+    }
+    return 1;
+}
+
+int lf()
+/* Author Haydn Gynn
+Company: Staffordshire University
+Created: 04/12/2020
+Modified: 17/10/2026
 Purpose: Decodes an S record file, loading it into memory
-Functions used: printf(), strToHex(), mgetchar()
+            Works a character at a time: wait for 'S', the record type, then pairs of hex digits.
+            Each record is decoded into a staging buffer and only written to memory by srecRecord() once it is
+            complete and its checksum is good, so a corrupt line loads nothing. Bad records are reported and skipped
+            rather than ending the load, so only those lines need sending again.
+            There are two staging buffers: a complete record waits in one (pending) while the next line is decoded
+            into the other, and is checked and written whenever the receive buffer is empty, in the time that would
+            otherwise be spent waiting for the next character. If the next record is complete first the pending one
+            is written straight away, which is counted as a stall. '>' is only sent if the transmit buffer has room,
+            so progress never holds up the load.
+            Finishes with the segments loaded, their sizes and the load time, rate, stalls,
+            receive overruns and the most the receive buffer held.
+            The range offered is the largest free region in the memory map, any region srecRecord() allows will load.
+Functions used: printf(), hexByte(), mgetchar(), srecRecord(), timeNow(), memoryLargest()
+Version: 2.2
+*/{
+    const Region *region = memoryLargest(MEM_LOAD);
+    int c, state = SREC_WAIT, type = 0, count = 0, received = 0, nibble = 0, result = 0, bad = 0, lineCount = 1, data, i;
+    int decoded = 0;
+    unsigned int records = 0, entry = 0, stalls = 0, overruns = rxOverruns;
+    unsigned long start = 0, bytes = 0, ms;
+    unsigned char sum = 0;
+    char pair[2];
+    SrecBuffer *stage = srecBuffers, *pending = NULL, *committed;
+
+    printf("\n%*cMotorola S decoder program\n", 10, ' ');
+    printf("%*c______________________", 12, ' ');
+    printf("%*c\n\n", 10, '_');
+    if (region == NULL){
+        printf("No free RAM in the memory map (regions.h), rebuild with cram.BAT\n");
+        return 0;
+    }
+    printf("Start the download for the file (Min Address: %04X, Max Address: %04X)\n\n", region->start, region->end);
+
+    srecSegmentCount = srecSymbols = 0;
+    rxHighWater = 0;
+    while(result != SREC_END){
+        //Check and write the pending record while nothing has arrived, or now if the next one is complete too
+        if (pending != NULL && (rxHead == rxTail || decoded)){
+            if (pending->sum != 0xFF){
+                result = SREC_CHECKSUM;
+            }else if (pending->count < srecAddressSize[pending->type] + 1){
+                result = SREC_SHORT;
+            }else{
+                result = srecRecord(pending->data, pending->type, pending->count, &records, &entry);
+            }
+            if (result < 0){
+                printf("\n%s - Line: %d", srecErrors[-result], pending->line);
+                bad++;
+            }else if (pending->type >= 1 && pending->type <= 3){
+                bytes += pending->count - srecAddressSize[pending->type] - 1;
+                if (((txHead + 1) & (TX_SIZE - 1)) != txTail){
+                    putchar('>');
+                }
+            }
+            committed = pending;
+            pending = NULL;
+            if (decoded){
+                pending = stage;
+                stage = committed;
+                decoded = 0;
+                stalls++;
+            }
+            continue;
+        }
+        c = mgetchar();
+
+        if (c == '\n'){
+            if (state != SREC_WAIT){
+                if (state != SREC_EOL){
+                    printf("\nIncomplete record - Line: %d", lineCount);
+                    bad++;
+                }
+                lineCount++;
+            }
+            state = SREC_WAIT;
+            continue;
+        }
+
+        switch (state) {
+            case SREC_WAIT:
+                if (c == 'S'){
+                    if (lineCount == 1){
+                        start = timeNow();      // Timed from the first record
+                    }
+                    state = SREC_TYPE;
+                }
+                break;
+
+            case SREC_TYPE:
+                type = c - '0';
+                if (type < 0 || type > 9 || srecAddressSize[type] == 0){
+                    printf("\nInvalid record type S%c - Line: %d", c, lineCount);
+                    bad++;
+                    state = SREC_EOL;
+                    break;
+                }
+                count = received = nibble = sum = 0;
+                state = SREC_DATA;
+                break;
+
+            case SREC_DATA:
+                pair[nibble++] = c;
+                if (nibble < 2){
+                    break;
+                }
+                nibble = 0;
+                if ((data = hexByte(pair)) == -1){
+                    printf("\nInvalid hex digits (%c%c) - Line: %d", pair[0], pair[1], lineCount);
+                    bad++;
+                    state = SREC_EOL;
+                    break;
+                }
+                sum += data;
+                if (received == 0){
+                    count = data;
+                }else{
+                    stage->data[received - 1] = data;
+                }
+                if (++received <= count){
+                    break;
+                }
+
+                //Whole record staged, it waits for the other buffer to be written
+                state = SREC_EOL;
+                stage->type = type;
+                stage->count = count;
+                stage->sum = sum;
+                stage->line = lineCount;
+                if (pending == NULL){
+                    pending = stage;
+                    stage = (stage == srecBuffers) ? srecBuffers + 1 : srecBuffers;
+                }else{
+                    decoded = 1;
+                }
+                break;
+        }
+    }
+    start = timeNow() - start;
+
+    if (bad){
+        printf("\n\nFile loaded with %d bad records, send those lines again", bad);
+    }else{
+        printf("\n\nFile sucessfully uploaded. Entry address: %04X", entry);
+    }
+    ms = start / (E_CLOCK / 1000);
+    printf("\n%u records, %lu bytes in %lu ms, %lu bytes/s", records, bytes, ms, ms ? bytes * 1000 / ms : 0);
+    printf("\n%u stalls, %u overruns, receive buffer peak %u of %u\n", stalls, rxOverruns - overruns, rxHighWater, RX_SIZE - 1);
+    printf("\nSegment   Start   End     Bytes");
+    for(i = 0; i < srecSegmentCount && i < SEGMENTS; i++){
+        printf("\n%4d      %04X    %04X    %u", i + 1, srecSegments[i].start,
+               srecSegments[i].start + srecSegments[i].length - 1, srecSegments[i].length);
+    }
+    if (srecSegmentCount > SEGMENTS){
+        printf("\n... and %d more", srecSegmentCount - SEGMENTS);
+    }
+    if (srecSymbols){
+        printf("\n%d symbols", symbolCount);
+    }
+    return bad == 0;
+}
+
+int srecRecord(unsigned char *stage, int type, int count, unsigned int *records, unsigned int *entry)
+/* Purpose: Used by lf
+            Acts on a record in stage (address, data, checksum) with a good checksum.
+            S1 and S2/S3 with addresses inside 16 bits are copied into memory, if the memory map lets them load there,
+            and added to the segment map. S0 is ignored, S5 is checked against the records loaded
+            and S9/S8/S7 end the file with the entry address.
+            S4 (not used by the standard) holds a symbol for dis, the address then the name in ASCII.
+            The first S4 of a load replaces the symbols loaded before.
+            Returns 0, SREC_END for the last record or a negative SREC_ error.
+Functions used: memoryAllows(), symbolAdd()
+Version: 1.2
+*/{
+    int size = srecAddressSize[type], length = count - size - 1, i;
+    unsigned int address = 0;
+    unsigned char *data = stage + size, *pointer;
+    Segment *segment;
+
+    for(i = 0; i < size; i++){
+        if (i < size - 2 && stage[i] != 0){
+            return SREC_RANGE;
+        }
+        address = (address << 8) | stage[i];
+    }
+
+    switch (type) {
+        case 1: case 2: case 3:
+            pointer = PTR(address);
+            if (length == 0){
+                break;
+            }
+            if (!memoryAllows(pointer, pointer + length - 1, MEM_LOAD)){
+                return SREC_RANGE;
+            }
+            for(i = 0; i < length; i++){
+                pointer[i] = data[i];
+            }
+            (*records)++;
+
+            //Add to the segment it follows or comes just before, or start a new one
+            for(i = 0, segment = srecSegments; i < srecSegmentCount && i < SEGMENTS; i++, segment++){
+                if (segment->start + segment->length == address){
+                    segment->length += length;
+                    return 0;
+                }
+                if (address + length == segment->start){
+                    segment->start = address;
+                    segment->length += length;
+                    return 0;
+                }
+            }
+            if (srecSegmentCount < SEGMENTS){
+                segment->start = address;
+                segment->length = length;
+            }
+            srecSegmentCount++;
+            break;
+        case 4:
+            if (srecSymbols++ == 0){
+                symbolCount = 0;
+            }
+            return symbolAdd(address, data, length);
+        case 5:
+            if (address != *records){
+                return SREC_COUNT;
+            }
+            break;
+        case 7: case 8: case 9:
+            *entry = address;
+            return SREC_END;
+    }
+    return 0;
+}
+
+int lb()
+/* Purpose: Binary load, about twice as fast as lf as each byte is sent once rather than as two hex characters.
+            The host (host/lbsend.c) sends frames of SOH, address (high, low), length (1-255), data, CRC16 (high, low)
+            with the CRC over the address, length and data. Each frame is received into a staging buffer (lf's first
+            record buffer) and only written to memory once its CRC is good, then answered with ACK, or NAK if it is
+            corrupt or stops part way, which the host resends. A corrupt frame writes nothing, so resending is safe.
+            A NAK is sent once the header is printed to start the transfer,
+            EOT finishes it and CAN aborts it (either way, CAN is sent back for a frame the memory map does not let load).
+            A frame starting STX (PACKED) instead of SOH (lbsend -z) holds packed data, which unpack() expands into memory
+            from the frame address, so zero filled tables and repeated code cost a few bytes to send.
+Functions used: printf(), putchar(), mgetbyte(), crc16(), unpack(), memoryAllows(), memoryLargest(), regionFind()
+Version: 1.3
+*/{
+    const Region *region = memoryLargest(MEM_LOAD);
+    int c, i, length, packed, size;
+    unsigned int address, crc, frames = 0, retries = 0;
+    unsigned long bytes = 0, sent = 0;
+    unsigned char header[3], *frame = srecBuffers[0].data, *pointer, *low = PTR(0xFFFF), *high = PTR(0);
+
+    printf("\n%*cBinary load\n", 10, ' ');
+    if (region == NULL){
+        printf("No free RAM in the memory map (regions.h), rebuild with cram.BAT\n");
+        return 0;
+    }
+    printf("Start the download (Min Address: %04X, Max Address: %04X)\n", region->start, region->end);
+    mflush();
+    putchar(NAK);
+
+    while(1){
+        c = mgetbyte(0);
+        if (c == EOT){
+            putchar(ACK);
+            break;
+        }
+        if (c == CAN){
+            printf("\nBinary load cancelled");
+            return 0;
+        }
+        if (c != SOH && c != PACKED){
+            continue;   // Resynchronise on the next frame
+        }
+        packed = c == PACKED;
+
+        //Header
+        crc = 0xFFFF;
+        for(i = 0; i < 3; i++){
+            if ((c = mgetbyte(RX_TIMEOUT)) == EOF){
+                break;
+            }
+            crc = crc16(crc, c);
+            header[i] = c;
+        }
+        if (c == EOF){
+            putchar(NAK);
+            retries++;
+            continue;
+        }
+        address = (header[0] << 8) | header[1];
+        length = header[2];
+        pointer = PTR(address);
+
+        //Data into the staging buffer, then the CRC
+        for(i = 0; i < length + 2; i++){
+            if ((c = mgetbyte(RX_TIMEOUT)) == EOF){
+                break;
+            }
+            if (i < length){
+                frame[i] = c;
+            }
+            crc = crc16(crc, c);
+        }
+        size = packed ? unpack(NULL, frame, length) : length;
+        if (c == EOF || crc != 0 || size < 0){  // The CRC of the data followed by its CRC is 0
+            putchar(NAK);
+            retries++;
+            continue;
+        }
+        if (size == 0 || !memoryAllows(pointer, pointer + size - 1, MEM_LOAD)){
+            region = regionFind(address);
+            putchar(CAN);
+            mflush();
+            printf("\nThe frame (%04X, %d bytes) is out of bounds (%s %04X -> %04X)", address, size,
+                    memoryTypes[region->type], region->start, region->end);
+            return 0;
+        }
+
+        //Good, into memory
+        if (packed){
+            unpack(pointer, frame, length);
+        }else{
+            for(i = 0; i < length; i++){
+                pointer[i] = frame[i];
+            }
+        }
+        putchar(ACK);
+
+        frames++;
+        sent += length;
+        bytes += size;
+        if (pointer < low){
+            low = pointer;
+        }
+        if (pointer + size - 1 > high){
+            high = pointer + size - 1;
+        }
+    }
+
+    mflush();
+    printf("\n\nFile sucessfully uploaded. %u frames, %lu bytes, %u resent", frames, bytes, retries);
+    if (sent != bytes){
+        printf("\n%lu bytes sent packed, %lu%%", sent, sent * 100 / bytes);
+    }
+    if (frames){
+        printf("\nStart address: %X, End address: %X", ADDR(low), ADDR(high));
+    }
+    return 1;
+}
+
+// Half step coil pattern for Port A0-A3
+const unsigned char stepSequence[8] = {0x01, 0x03, 0x02, 0x06, 0x04, 0x0C, 0x08, 0x09};
+
+// E-clock cycles between half steps for each ADR1 value, 0 in the dead band around POT_MIDPOINT (0x59-0x85).
+// Worked out off line as E_CLOCK / (50 + 950 * d * d), d going from 0 at the dead band to 1 at the end of the pot,
+// so 50 to 1000 half steps a second with fine control at low speed.
+const unsigned int stepPeriods[256] = {
+/* 00 */  2000,  2043,  2088,  2134,  2182,  2232,  2283,  2335,
+/* 08 */  2390,  2446,  2505,  2565,  2628,  2693,  2760,  2830,
+/* 10 */  2902,  2977,  3055,  3136,  3221,  3308,  3399,  3494,
+/* 18 */  3592,  3695,  3802,  3914,  4030,  4151,  4278,  4411,
+/* 20 */  4549,  4694,  4845,  5003,  5169,  5343,  5526,  5717,
+/* 28 */  5918,  6129,  6351,  6584,  6829,  7087,  7359,  7646,
+/* 30 */  7949,  8268,  8605,  8961,  9337,  9735, 10156, 10602,
+/* 38 */ 11074, 11573, 12102, 12663, 13257, 13886, 14553, 15258,
+/* 40 */ 16005, 16795, 17630, 18510, 19438, 20414, 21437, 22508,
+/* 48 */ 23624, 24782, 25979, 27208, 28462, 29731, 31002, 32261,
+/* 50 */ 33493, 34677, 35793, 36820, 37737, 38522, 39155, 39620,
+/* 58 */ 39904,     0,     0,     0,     0,     0,     0,     0,
+/* 60 */     0,     0,     0,     0,     0,     0,     0,     0,
+/* 68 */     0,     0,     0,     0,     0,     0,     0,     0,
+/* 70 */     0,     0,     0,     0,     0,     0,     0,     0,
+/* 78 */     0,     0,     0,     0,     0,     0,     0,     0,
+/* 80 */     0,     0,     0,     0,     0,     0, 39949, 39797,
+/* 88 */ 39546, 39199, 38763, 38243, 37645, 36979, 36252, 35472,
+/* 90 */ 34648, 33789, 32902, 31995, 31075, 30148, 29220, 28297,
+/* 98 */ 27382, 26479, 25593, 24724, 23876, 23051, 22249, 21471,
+/* A0 */ 20719, 19992, 19290, 18614, 17963, 17337, 16735, 16157,
+/* A8 */ 15602, 15069, 14558, 14068, 13598, 13147, 12715, 12301,
+/* B0 */ 11904, 11523, 11158, 10807, 10472, 10149,  9840,  9543,
+/* B8 */  9259,  8985,  8723,  8470,  8228,  7995,  7771,  7555,
+/* C0 */  7348,  7149,  6957,  6772,  6593,  6422,  6256,  6097,
+/* C8 */  5943,  5795,  5652,  5513,  5380,  5251,  5126,  5006,
+/* D0 */  4890,  4777,  4668,  4563,  4461,  4362,  4266,  4174,
+/* D8 */  4084,  3997,  3913,  3831,  3752,  3675,  3600,  3527,
+/* E0 */  3457,  3389,  3322,  3257,  3195,  3134,  3074,  3017,
+/* E8 */  2960,  2906,  2853,  2801,  2751,  2701,  2654,  2607,
+/* F0 */  2562,  2517,  2474,  2432,  2391,  2351,  2312,  2274,
+/* F8 */  2237,  2201,  2165,  2131,  2097,  2064,  2032,  2000
+};
+
+int demo()
+/* Author Haydn Gynn
+Company: Staffordshire University
+Created: 04/12/2020
+Modified: 17/10/2026
+Purpose: A simple program which uses a potentiometer to control the speed of a motor
+            The motor is stepped by stepIsr() on the TOC2 output compare, so steps are evenly spaced
+            and this loop only reports the step rate, until a key is pressed.
+Functions used: printf(), timeNow(), mgetbyte(), mflush()
+Version: 2.0
+*/{
+    unsigned long now, last;
+    unsigned int steps, rate, maxRate = 0;
+
+    REG_WRITE(R_ADCTL, 0x20);                   /*Continuous scan of AN0*/
+    REG_WRITE(R_DDRA, 0x0F);                    /*Port A 0-3 outputs (coils)*/
+
+    printf("Motor demo (BI-Directional) - Potentiometer control\n\n");
+    printf("Plug RED Power wire to 5Volt on board\n");
+    printf("Plug BLACK Power wire to GND on board\n\n");
+    printf("Plug Stepper RED wire to PORT A0\n");
+    printf("Plug Stepper WHITE wire to PORT A1\n");
+    printf("Plug Stepper GREEN wire to PORT A2\n");
+    printf("Plug Stepper BLACK wire to PORT A3\n\n");
+    printf("Plug Potentiometer RED Power wire to 5Volt on board\n");
+    printf("Plug Potentiometer BLACK Power wire to GND on board\n");
+    printf("Plug Potentiometer GREEN wire to E0\n\n");
+    printf("Watch motor spin, the potentiometer will alter speed and direction\n");
+    printf("Press any key to stop\n\n");
+
+    stepCount = stepLate = 0;
+    SET_VECTOR(PV_TOC2, stepIsr);
+    REG_WRITE16(R_TOC2, REG_READ16(R_TCNT) + STEP_IDLE);    /*First check of the pot*/
+    REG_WRITE(R_TFLG1, 0x40);                               /*Clear OC2F*/
+    REG_WRITE(R_TMSK1, REG_READ(R_TMSK1) | 0x40);           /*OC2I*/
+
+    last = timeNow();
+    steps = stepCount;
+    while(mgetbyte(1) == EOF){
+        if ((now = timeNow()) - last < STEP_REPORT){
+            continue;
+        }
+        rate = (unsigned int)((unsigned long)(stepCount - steps) * E_CLOCK / (now - last));
+        maxRate = rate > maxRate ? rate : maxRate;
+        printf("\rSteps/s %4u  Max %4u  Late %4u cycles ", rate, maxRate, stepLate);
+        steps = stepCount;
+        last = now;
+    }
+
+    REG_WRITE(R_TMSK1, REG_READ(R_TMSK1) & ~0x40);  /*OC2I off, stop stepping*/
+    REG_WRITE(R_PORTA, 0x00);                       /*Coils off*/
+    printf("\n%u steps, max %u steps/s, worst step %u cycles late\n", stepCount, maxRate, stepLate);
+    return 1;
+}
+
+int prof(unsigned char *start, unsigned char *end)
+/* Purpose: Runs the program at start as go does, with profIsr() sampling where it is on every RTI (4.1ms),
+            then lists where it spent its time. Samples between start and end go into PROF_BUCKETS buckets.
+            The profile is kept at PROF_BLOCK, so if the program never returns,
+            reset the board and type prof to see it.
+            A program that masks interrupts is not sampled while they are masked.
+Functions used: mflush(), profReport()
+Version: 1.0
+*/{
+    Profile *profile = (Profile *)PTR(PROF_BLOCK);
+    unsigned int i;
+
+    profile->start = ADDR(start);
+    profile->end = ADDR(end);
+    for(profile->shift = 0; ((profile->end - profile->start) >> profile->shift) >= PROF_BUCKETS; profile->shift++);
+    profile->samples = 0;
+    profile->outside = 0;
+    for(i = 0; i < PROF_BUCKETS; i++){
+        profile->buckets[i] = 0;
+    }
+    profile->magic = PROF_MAGIC;
+
+    mflush(); // Programs may drive the SCI themselves
+    FRAME_VECTOR(PV_RTI, profStub, profIsr);
+    REG_WRITE(R_PACTL, REG_READ(R_PACTL) & ~0x03);  /*RTR, fastest RTI*/
+    REG_WRITE(R_TFLG2, 0x40);                       /*Clear RTIF*/
+    REG_WRITE(R_TMSK2, REG_READ(R_TMSK2) | 0x40);   /*RTII*/
+    CALL(start);
+    REG_WRITE(R_TMSK2, REG_READ(R_TMSK2) & ~0x40);
+    ENABLE_INTERRUPTS(); // In case the program masked them, output would stall
+
+    return profReport();
+}
+
+int profReport()
+/* Purpose: Lists the PROF_TOP buckets with the most samples in the last profile, each with its share of
+            the samples and its disassembly. The range is decoded from its start each time,
+            so instructions line up as dis would show them.
+Functions used: printf(), decodeInstruction(), disRow(), mputs()
+Version: 1.0
+*/{
+    Profile *profile = (Profile *)PTR(PROF_BLOCK);
+    char instruction[32], row[ROW_SIZE];
+    unsigned char *pointer, listed[PROF_BUCKETS];
+    unsigned int i, top, best, first, last, length;
+
+    if (profile->magic != PROF_MAGIC){
+        printf("\nNo profile yet, use prof 'start'");
+        return 0;
+    }
+    printf("\n%lu samples, %u outside %04X-%04X", profile->samples, profile->outside, profile->start, profile->end);
+
+    for(i = 0; i < PROF_BUCKETS; i++){
+        listed[i] = 0;
+    }
+    for(top = 0; top < PROF_TOP; top++){
+        for(i = 0, best = PROF_BUCKETS; i < PROF_BUCKETS; i++){
+            if (!listed[i] && profile->buckets[i] && (best == PROF_BUCKETS || profile->buckets[i] > profile->buckets[best])){
+                best = i;
+            }
+        }
+        if (best == PROF_BUCKETS){
+            break;
+        }
+        listed[best] = 1;
+
+        first = profile->start + (best << profile->shift);
+        last = first + (1 << profile->shift) - 1;
+        last = last > profile->end ? profile->end : last;
+        printf("\n\n%04X-%04X  %u samples  %lu%%", first, last, profile->buckets[best],
+                (unsigned long)profile->buckets[best] * 100 / profile->samples);
+
+        for(pointer = PTR(profile->start), i = 1; ADDR(pointer) <= last; pointer += length){
+            length = decodeInstruction(pointer, instruction);
+            if (ADDR(pointer) + length > first){
+                disRow(row, pointer, length, i++, instruction);
+                mputs(row);
+            }
+        }
+    }
+    return 1;
+}
+
+int bench(unsigned char *start, unsigned int calls)
+/* Purpose: Calls the routine at start as go does, calls times, reading timeNow() either side of each call,
+            and lists the fewest, mean and most E-clock cycles and microseconds a call took.
+            The cost of timing itself is measured first and taken off, so the cycles include the
+            routine and its JSR/RTS only. Interrupts still run, as they would for the real program.
+            A routine that masks interrupts for more than 32ms misses timer overflows and is timed short.
+Functions used: mflush(), timeNow(), printf()
+Version: 1.0
+*/{
+    unsigned long before, overhead, cycles, least = 0xFFFFFFFFUL, most = 0, total = 0;
+    unsigned int i;
+
+    mflush(); // Programs may drive the SCI themselves
+    before = timeNow();
+    ENABLE_INTERRUPTS();
+    overhead = timeNow() - before;
+    for(i = 0; i < calls; i++){
+        before = timeNow();
+        CALL(start);
+        ENABLE_INTERRUPTS(); // In case the program masked them, the overflows would not be counted
+        cycles = timeNow() - before - overhead;
+        total += cycles;
+        least = cycles < least ? cycles : least;
+        most = cycles > most ? cycles : most;
+    }
+
+    printf("\n%u calls       Cycles          us", calls);
+    printf("\nMin    %12lu %11lu", least, least / E_PER_US);
+    printf("\nMean   %12lu %11lu", total / calls, total / calls / E_PER_US);
+    printf("\nMax    %12lu %11lu", most, most / E_PER_US);
+    return 1;
+}
+
+int bp(unsigned char *address)
+/* Purpose: Sets a breakpoint at address, or lists them when address is NULL.
+            The SWI only goes into memory while a program runs (see insertBreakpoints()),
+            so dm and dis always show the real code. Only memory the map lets the monitor write can take one.
+Functions used: printf(), memoryWritable()
+Version: 1.1
+*/{
+    int i, free = -1;
+
+    for(i = 0; i < BREAKPOINTS; i++){
+        if (address == NULL && breakpoints[i].address != NULL){
+            printf("\n%d  %04X", i, ADDR(breakpoints[i].address));
+        }else if (address != NULL && breakpoints[i].address == address){
+            return 1;
+        }else if (breakpoints[i].address == NULL && free < 0){
+            free = i;
+        }
+    }
+    if (address == NULL){
+        return 1;
+    }
+    if (!memoryWritable(address, address)){
+        return 0;
+    }
+    if (free < 0){
+        printf("\nAll %d breakpoints are in use, clear one with bc", BREAKPOINTS);
+        return 0;
+    }
+    breakpoints[free].address = address;
+    return 1;
+}
+
+int bc(unsigned char *address)
+/* Purpose: Clears the breakpoint at address, or all of them when address is NULL.
+Functions used: printf()
+Version: 1.0
+*/{
+    int i, found = 0;
+
+    for(i = 0; i < BREAKPOINTS; i++){
+        if (address == NULL || breakpoints[i].address == address){
+            breakpoints[i].address = NULL;
+            found = 1;
+        }
+    }
+    if (!found){
+        printf("\nNo breakpoint at %04X", ADDR(address));
+    }
+    return found;
+}
+
+int step()
+/* Purpose: Runs one instruction of the stopped program, by putting step's own breakpoints on every
+            instruction that can come next (see stepTargets()) and letting it carry on.
+            The other breakpoints are left out, so the step cannot stop anywhere else.
+Functions used: printf(), stepTargets(), insertBreakpoints()
+Version: 1.0
+*/{
+    unsigned char *targets[2];
+    int count;
+
+    if (breakFrame == NULL){
+        printf("\nNo program is stopped, set a breakpoint with bp and use go");
+        return 0;
+    }
+    if ((count = stepTargets(breakFrame, targets)) == 0){
+        printf("\nCannot step this instruction, use go");
+        return 0;
+    }
+    breakpoints[BREAKPOINTS].address = targets[0];
+    breakpoints[BREAKPOINTS + 1].address = count > 1 ? targets[1] : NULL;
+    if (!insertBreakpoints(BREAKPOINTS, BREAKPOINTS + 2)){
+        return 0;
+    }
+    breakStepOver = 0;
+    breakResume = 1;
+    return 1;
+}
+
+int stepTargets(unsigned char *frame, unsigned char **targets)
+/* Purpose: Works out where the stopped program at frame can be after its next instruction,
+            from lookupInstruction() and the stacked registers. Returns how many targets, 2 for a
+            conditional branch (the next instruction and the branch target), 0 if it cannot be
+            stepped (SWI, WAI, STOP) or it leaves the monitor's range (the final RTS back to go).
+Functions used: lookupInstruction()
+Version: 1.0
+*/{
+    unsigned char *pc = PTR(FRAME_WORD(frame, FRAME_PC)), *operand, *stack = frame + FRAME_SIZE;
+    unsigned int prefix, index;
+    Opcode entry = lookupInstruction(pc, &prefix);
+    int count = 1;
+
+    operand = pc + (prefix != 0);
+    index = (prefix == 0x18 || prefix == 0xCD) ? FRAME_WORD(frame, FRAME_Y) : FRAME_WORD(frame, FRAME_X);
+    targets[0] = operand + AM_LENGTH(entry.mode);
+
+    switch (entry.mnemonic) {
+        case SWI:
+        case WAI:
+        case STOP:
+            return 0;
+        case RTS:
+            targets[0] = PTR(FRAME_WORD(stack, 0));
+            break;
+        case RTI:
+            targets[0] = PTR(FRAME_WORD(stack, FRAME_PC));
+            break;
+        case BSR:
+            targets[0] = operand + 2 + (signed char)operand[1];
+            break;
+        case JMP:
+        case JSR:
+            if (AM_MODE(entry.mode) == AM_EXT){
+                targets[0] = PTR(FRAME_WORD(operand, 1));
+            }else if (AM_MODE(entry.mode) == AM_DIR){
+                targets[0] = PTR(operand[1]);
+            }else{
+                targets[0] = PTR(index + operand[1]);
+            }
+            break;
+        default:
+            if (AM_MODE(entry.mode) == AM_REL){
+                targets[count++] = operand + 2 + (signed char)operand[1];
+            }else if (AM_MODE(entry.mode) == AM_DIR_BRANCH || AM_MODE(entry.mode) == AM_IND_BRANCH){
+                targets[count++] = operand + 4 + (signed char)operand[3];
+            }
+            if (count > 1 && targets[1] == targets[0]){
+                count = 1;
+            }
+    }
+    if (targets[0] < MIN || targets[0] > MAX){
+        return 0;
+    }
+    return count;
+}
+
+int regs()
+/* Purpose: Lists the stopped program's registers as they were stacked by the SWI, SP as the program
+            will see it again, the CCR flags by name (upper case set), then the instruction it stopped at.
+Functions used: printf(), decodeInstruction(), disRow(), mputs()
+Version: 1.0
+*/{
+    char instruction[32], row[ROW_SIZE], flags[9];
+    unsigned char *pc;
+    int i;
+
+    if (breakFrame == NULL){
+        printf("\nNo program is stopped");
+        return 0;
+    }
+    for(i = 0; i < 8; i++){
+        flags[i] = (breakFrame[FRAME_CCR] & (0x80 >> i)) ? "SXHINZVC"[i] : "sxhinzvc"[i];
+    }
+    flags[8] = '\0';
+    printf("\nA %02X  B %02X  X %04X  Y %04X  SP %04X  CCR %02X %s", breakFrame[FRAME_A], breakFrame[FRAME_B],
+            FRAME_WORD(breakFrame, FRAME_X), FRAME_WORD(breakFrame, FRAME_Y), ADDR(breakFrame) + FRAME_SIZE - 1,
+            breakFrame[FRAME_CCR], flags);
+
+    pc = PTR(FRAME_WORD(breakFrame, FRAME_PC));
+    i = decodeInstruction(pc, instruction);
+    disRow(row, pc, i, 1, instruction);
+    mputs(row);
+    return 1;
+}
+
+int insertBreakpoints(int first, int last)
+/* Purpose: Writes an SWI over the instruction at each breakpoint in slots first to last - 1, saving the
+            byte it replaces. A breakpoint that does not read back as SWI is not in RAM and is dropped.
+            Returns 0 if any were dropped.
+Functions used: printf()
+Version: 1.0
+*/{
+    int i, result = 1;
+
+    for(i = first; i < last; i++){
+        if (breakpoints[i].address != NULL && !breakpoints[i].inserted){
+            breakpoints[i].saved = *breakpoints[i].address;
+            *breakpoints[i].address = SWI_OPCODE;
+            if (*breakpoints[i].address != SWI_OPCODE){
+                printf("\nCannot break at %04X, not RAM", ADDR(breakpoints[i].address));
+                breakpoints[i].address = NULL;
+                result = 0;
+            }else{
+                breakpoints[i].inserted = 1;
+            }
+        }
+    }
+    return result;
+}
+
+void removeBreakpoints()
+/* Purpose: Puts back the bytes under every inserted SWI, last first in case two share an address,
+            and frees step's slots.
+Version: 1.0
+*/{
+    int i;
+
+    for(i = BREAKPOINTS + 1; i >= 0; i--){
+        if (breakpoints[i].inserted){
+            *breakpoints[i].address = breakpoints[i].saved;
+            breakpoints[i].inserted = 0;
+        }
+    }
+    breakpoints[BREAKPOINTS].address = breakpoints[BREAKPOINTS + 1].address = NULL;
+}
+
+int servo(int channel, int angle)
+/* Purpose: Sets the angle of a servo driven by servo.c, which must have been loaded with lf and started with go,
+            then lists the angle of each channel. Channel 0 only lists them.
+            The new angle is used from the next 20ms period.
+Functions used: printf()
+Version: 1.0
+*/{
+    unsigned char *block = PTR(SERVO_BLOCK), *angles = block + 1;
+    int i;
+
+    if (*block != SERVO_MAGIC){
+        printf("\nThe servo driver is not running, load servo.c with lf and start it with go");
+        return 0;
+    }
+    if (channel){
+        angles[channel - 2] = angle;
+    }
+
+    for(i = 0; i < SERVO_CHANNELS; i++){
+        if (angles[i] == SERVO_OFF){
+            printf("\nOC%d  off", i + 2);
+        }else{
+            printf("\nOC%d  %3u degrees", i + 2, angles[i]);
+        }
+    }
+    return 1;
+}
+
+int serialStat()
+/* Purpose: Outputs the serial port counters, how many characters are waiting in each direction,
+            the most each buffer has held and how many characters have been lost since power up
+            (the receive high water since the last lf, which starts it again for its own report).
+Functions used: printf()
+Version: 1.1
+*/{
+    printf("\nRX buffered       : %u", (unsigned char)(rxHead - rxTail) & (RX_SIZE - 1));
+    printf("\nRX high water     : %u of %u", rxHighWater, RX_SIZE - 1);
+    printf("\nRX overruns       : %u", rxOverruns);
+    printf("\nTX buffered       : %u", (unsigned char)(txHead - txTail) & (TX_SIZE - 1));
+    printf("\nTX high water     : %u of %u", txHighWater, TX_SIZE - 1);
+    printf("\nTX dropped        : %u", txDropped);
+
+    return 1;
+}
+
+// ################# Interrupt Handlers ######################
+
+void sciInit()
+/* Purpose: Installs the SCI interrupt handler into its pseudo vector, enables the receive interrupt (SCCR2 RIE)
+            and unmasks interrupts. The transmit interrupt is enabled by mputchar() when there is something to send.
 Version: 1.0
 */{
-    int data, lineLength, count = 0, checksum = 0, sum, lineCount = 1;
-    char buffer[10],*startAddr,*pointer, *lastAddr;
+    SET_VECTOR(PV_SCI, sciIsr);
+    REG_WRITE(R_SCCR2, REG_READ(R_SCCR2) | 0x20);   /*RIE*/
+    ENABLE_INTERRUPTS();
+}
 
-    printf("\n%*cMotorola S decoder program\n", 10, ' ');
-    printf("%*c______________________", 12, ' ');
-    printf("%*c\n\n", 10, '_');
-    printf("Start the download for the file (Min Address: %04X, Max Address: %04X)\n\n", LF_START, LF_MAX);
+INTERRUPT void sciIsr(void)
+/* Purpose: SCI interrupt, moves a received character into the receive ring buffer
+            and the next character from the transmit ring buffer into the SCI.
+            Reading SCSR then SCDR clears RDRF and OR. A character lost in the SCI (OR)
+            or dropped because the buffer is full is counted in rxOverruns.
+            The transmit interrupt (SCCR2 TIE) is turned off once the transmit buffer is empty.
+            The most the receive buffer has held is kept in rxHighWater.
+Version: 1.2
+*/{
+    unsigned char status, data, next;
 
-    while(1){
-        count = 0;
-        //Read in first 8 characters, ensuring first value is an 'S'
-        while (count < 8){
-            buffer[count++] = mgetchar();
-            if(buffer[0] != 'S'){
-                count = 0;
+    status = REG_READ(R_SCSR);
+    if (status & 0x28){                         /*RDRF or OR*/
+        data = REG_READ(R_SCDR);
+        if (status & 0x08){
+            rxOverruns++;
+        }
+
+        next = (rxHead + 1) & (RX_SIZE - 1);
+        if (next == rxTail){
+            rxOverruns++;
+        }else{
+            rxBuffer[rxHead] = data;
+            rxHead = next;
+            if (((next - rxTail) & (RX_SIZE - 1)) > rxHighWater){
+                rxHighWater = (next - rxTail) & (RX_SIZE - 1);
             }
         }
-        if(buffer[1] != '1' && buffer[1] != '9'){
-            printf("\nInvalid start of line - Line: %d",lineCount);
-            return 0;
+    }
+
+    if ((status & 0x80) && (REG_READ(R_SCCR2) & 0x80)){ /*TDRE and TIE*/
+        if (txHead == txTail){
+            REG_WRITE(R_SCCR2, REG_READ(R_SCCR2) & ~0x80);
+        }else{
+            REG_WRITE(R_SCDR, txBuffer[txTail]);
+            txTail = (txTail + 1) & (TX_SIZE - 1);
+            txStalled = 0;
         }
+    }
+}
 
-        lineLength = strToHex(buffer + 2, 1);
-        startAddr = (char *) strToHex(buffer + 4, 2);
+void timerInit()
+/* Purpose: Installs the timer overflow interrupt, which extends TCNT to 32 bits for timeNow().
+Version: 1.0
+*/{
+    SET_VECTOR(PV_TOF, tofIsr);
+    REG_WRITE(R_TFLG2, 0x80);                       /*Clear TOF*/
+    REG_WRITE(R_TMSK2, REG_READ(R_TMSK2) | 0x80);   /*TOI*/
+}
 
-        if (lineLength == -1 || startAddr == (char *)-1){
-            printf("\nInvalid hex digits in 'length' or 'start address' - Line: %d",lineCount);
-            return 0;
-        }
-        if (startAddr < LF_START || startAddr > LF_MAX){
-            printf("\nThe line startAddress(%X) is out of bounds (%04X -> %04X) - Line: %d", startAddr,LF_START, LF_MAX, lineCount);
-            return 0;
-        }
+INTERRUPT void tofIsr(void)
+/* Purpose: Timer overflow interrupt, every 65536 E-clock cycles (32.8ms).
+Version: 1.0
+*/{
+    REG_WRITE(R_TFLG2, 0x80);                   /*Clear TOF*/
+    tofCount++;
+}
 
-        sum = ((int)startAddr >> 8) + ((int)startAddr & 0xFF)  + lineLength;
-        pointer = startAddr;
-        //Read the rest of the line
-        while (startAddr < (pointer + lineLength-2)){
-            buffer[8] = mgetchar();
-            buffer[9] = mgetchar();
-            if ((data = strToHex(buffer + 8, 1)) == -1){
-                printf("\nInvalid hex digits in the 'data' - Line: %d - (%c%c)",lineCount, buffer[8],buffer[9]);
-                return 0;
-            }
-            if(startAddr == (pointer + lineLength-3)){
-                checksum = data;
-                break;
-            }
-            sum = sum + data;
-            *startAddr++ = data;
-        }
+INTERRUPT void stepIsr(void)
+/* Purpose: TOC2 output compare interrupt for demo. Takes a half step in the direction the potentiometer is turned,
+            then sets the next compare from stepPeriods. Compares are set from the last one, not from TCNT,
+            so a late interrupt does not stretch the period. Keeps the worst lateness seen in stepLate.
+Version: 1.0
+*/{
+    unsigned char adc = REG_READ(R_ADR1);
+    unsigned int period = stepPeriods[adc], compare = REG_READ16(R_TOC2), late;
+
+    REG_WRITE(R_TFLG1, 0x40);                   /*Clear OC2F*/
+    late = (REG_READ16(R_TCNT) - compare) & 0xFFFF;
+    stepLate = late > stepLate ? late : stepLate;
+
+    if (period == 0){
+        period = STEP_IDLE;                         // Dead band, hold position
+    }else{
+        stepIndex = (stepIndex + (adc > POT_MIDPOINT ? 1 : -1)) & 7;
+        REG_WRITE(R_PORTA, stepSequence[stepIndex]);
+        stepCount++;
+    }
+    REG_WRITE16(R_TOC2, compare + period);
+}
 
-        sum = (~(sum)) & 0xFF;
-        if (checksum == 0 || sum != checksum){
-            printf("\nChecksum failed Expected: %02X, Actual: %02X - Line: %d", checksum,sum, lineCount);
-            return 0;
+INTERRUPT void profIsr(void)
+/* Purpose: RTI interrupt for prof, adds where the interrupted code was to the profile.
+Version: 1.0
+*/{
+    Profile *profile = (Profile *)PTR(PROF_BLOCK);
+    unsigned int pc = FRAME_WORD(INTERRUPT_FRAME(), FRAME_PC), *bucket;
+
+    REG_WRITE(R_TFLG2, 0x40);                   /*Clear RTIF*/
+    profile->samples++;
+    if (pc < profile->start || pc > profile->end){
+        bucket = &profile->outside;
+    }else{
+        bucket = &profile->buckets[(pc - profile->start) >> profile->shift];
+    }
+    if (*bucket != 0xFFFF){
+        (*bucket)++;
+    }
+}
+
+INTERRUPT void swiIsr(void)
+/* Purpose: SWI interrupt, from a breakpoint, a step or an SWI in the program itself.
+            Takes the SWIs out and, for a breakpoint, backs the stacked PC up onto the instruction it replaced.
+            When go is stepping over a breakpoint (breakStepOver) this is the end of that step,
+            so the breakpoints go back in and the program carries on.
+            Otherwise it shows where the program stopped and runs the monitor (commandLoop()) with
+            interrupts on until go or step, anything they change in the frame is unstacked by the RTI.
+Functions used: removeBreakpoints(), insertBreakpoints(), printf(), regs(), commandLoop(), mflush()
+Version: 1.0
+*/{
+    unsigned char *frame = INTERRUPT_FRAME(), *outer = breakFrame, *pc;
+    int i;
+
+    pc = PTR(FRAME_WORD(frame, FRAME_PC) - 1);
+    for(i = BREAKPOINTS + 1; i >= 0 && !(breakpoints[i].inserted && breakpoints[i].address == pc); i--);
+    removeBreakpoints();
+    if (i >= 0){
+        frame[FRAME_PC] = ADDR(pc) >> 8;
+        frame[FRAME_PC + 1] = ADDR(pc) & 0xFF;
+    }else{
+        pc++;
+    }
+    if (i >= BREAKPOINTS && breakStepOver){
+        breakStepOver = 0;
+        for(i = 0; i < BREAKPOINTS && breakpoints[i].address != pc; i++);
+        if (i == BREAKPOINTS){
+            insertBreakpoints(0, BREAKPOINTS);
+            return;
         }
+    }
+    breakStepOver = 0;
+
+    printf("\n%s at %04X", i < 0 ? "SWI" : i < BREAKPOINTS ? "Breakpoint" : "Step", ADDR(pc));
+    breakFrame = frame;
+    regs();
+    ENABLE_INTERRUPTS();
+    commandLoop();
+    mflush(); // Programs may drive the SCI themselves
+    DISABLE_INTERRUPTS();
+    breakFrame = outer;
+}
 
-        putchar('>');
-        if(buffer[1] == '9'){
-            printf("\n\nFile sucessfully uploaded. Start address: %X, End address: %X", pointer, lastAddr);
-            break;
+unsigned long timeNow()
+/* Purpose: Returns E-clock cycles since power up (wraps after about 35 minutes), from the overflow count and TCNT.
+            Reads again if an overflow was counted part way through.
+Version: 1.0
+*/{
+    unsigned int high, low;
+
+    do{
+        high = tofCount;
+        low = REG_READ16(R_TCNT);
+    }while(high != tofCount);
+
+    return ((unsigned long)high << 16) | low;
+}
+
+// ################# Hex codec ######################
+
+// Value of each character as a hex digit, -1 if it is not one
+const signed char hexValues[256] = {
+/* 00 */ -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+/* 10 */ -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+/* 20 */ -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+/* 30 */  0, 1, 2, 3, 4, 5, 6, 7, 8, 9,-1,-1,-1,-1,-1,-1,
+/* 40 */ -1,10,11,12,13,14,15,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+/* 50 */ -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+/* 60 */ -1,10,11,12,13,14,15,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+/* 70 */ -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+/* 80 */ -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+/* 90 */ -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+/* A0 */ -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+/* B0 */ -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+/* C0 */ -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+/* D0 */ -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+/* E0 */ -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+/* F0 */ -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1
+};
+
+// Two hex digits for each byte, hexPairs[byte * 2]
+const char hexPairs[] =
+    "000102030405060708090A0B0C0D0E0F"
+    "101112131415161718191A1B1C1D1E1F"
+    "202122232425262728292A2B2C2D2E2F"
+    "303132333435363738393A3B3C3D3E3F"
+    "404142434445464748494A4B4C4D4E4F"
+    "505152535455565758595A5B5C5D5E5F"
+    "606162636465666768696A6B6C6D6E6F"
+    "707172737475767778797A7B7C7D7E7F"
+    "808182838485868788898A8B8C8D8E8F"
+    "909192939495969798999A9B9C9D9E9F"
+    "A0A1A2A3A4A5A6A7A8A9AAABACADAEAF"
+    "B0B1B2B3B4B5B6B7B8B9BABBBCBDBEBF"
+    "C0C1C2C3C4C5C6C7C8C9CACBCCCDCECF"
+    "D0D1D2D3D4D5D6D7D8D9DADBDCDDDEDF"
+    "E0E1E2E3E4E5E6E7E8E9EAEBECEDEEEF"
+    "F0F1F2F3F4F5F6F7F8F9FAFBFCFDFEFF";
+
+int hexByte(char *text)
+/* Purpose: Converts two hex digits into a byte, returning -1 if either is not a hex digit.
+Version: 1.0
+*/{
+    int high = hexValues[(unsigned char)text[0]], low = hexValues[(unsigned char)text[1]];
+
+    if ((high | low) < 0){
+        return -1;
+    }
+    return (high << 4) | low;
+}
+
+int hexWord(char *text, unsigned int *value)
+/* Purpose: Converts up to 4 hex digits, stopping at the first character that is not one.
+            Returns how many digits were used, or 0 if there were none or too many for 16 bits.
+Version: 1.0
+*/{
+    int digits, digit;
+
+    *value = 0;
+    for(digits = 0; (digit = hexValues[(unsigned char)text[digits]]) >= 0; digits++){
+        if (digits == 4){
+            return 0;
         }
-        lineCount++;
-        lastAddr = startAddr;
+        *value = (*value << 4) | digit;
     }
-    return 1;
+    return digits;
 }
 
-int demo()
-/* Author Haydn Gynn
-Company: Staffordshire University
-Created: 04/12/2020
-Purpose: A simple program which uses a potentiometer to control the speed of a motor
+char *hexPut(char *out, unsigned char byte)
+/* Purpose: Writes a byte as two hex digits, returning where the next character goes.
 Version: 1.0
 */{
-    unsigned char * portA, *ddrA, *adctl,*adr1;
-    int timer = 0, counter = 0, sequence[8] = {1, 2, 3, 6, 4, 12, 8, 9};
-    double delay;
-    adctl=(unsigned char*)0x30;
-    *adctl=0x20;
-    adr1=(unsigned char*)0x31;
-    portA=(unsigned char *)0x00;	/*Port A Data register*/
-    ddrA=(unsigned char *)0x01;	    /*Port A Data Direction register*/
-    *ddrA = 0x0F;                   /* PortA Input=0/Output=1 */
+    const char *pair = hexPairs + (byte << 1);
 
-    printf("Motor demo (BI-Directional) - Potentiometer control\n\n");
-    printf("Plug RED Power wire to 5Volt on board\n");
-    printf("Plug BLACK Power wire to GND on board\n\n");
-    printf("Plug Stepper RED wire to PORT A0\n");
-    printf("Plug Stepper WHITE wire to PORT A1\n");
-    printf("Plug Stepper GREEN wire to PORT A2\n");
-    printf("Plug Stepper BLACK wire to PORT A3\n\n");
-    printf("Plug Potentiometer RED Power wire to 5Volt on board\n");
-    printf("Plug Potentiometer BLACK Power wire to GND on board\n");
-    printf("Plug Potentiometer GREEN wire to E0\n\n");
-    printf("Watch motor spin, the potentiometer will alter speed and direction\n");
+    out[0] = pair[0];
+    out[1] = pair[1];
+    return out + 2;
+}
+
+char *hexPutWord(char *out, unsigned int word)
+/* Purpose: Writes a 16 bit value as four hex digits.
+Version: 1.0
+*/{
+    return hexPut(hexPut(out, word >> 8), word & 0xFF);
+}
+
+char *decPut(char *out, unsigned int value, int width)
+/* Purpose: Writes a value in decimal, right aligned in width characters (or wider if it needs more).
+Version: 1.0
+*/{
+    char digits[5];
+    int count = 0;
+
+    do{
+        digits[count++] = '0' + value % 10;
+        value /= 10;
+    }while(value);
+    while(width-- > count){
+        *out++ = ' ';
+    }
+    while(count){
+        *out++ = digits[--count];
+    }
+    return out;
+}
+
+char *textPut(char *out, const char *text)
+/* Purpose: Copies a string without its terminator, returning where the next character goes.
+Version: 1.0
+*/{
+    while(*text){
+        *out++ = *text++;
+    }
+    return out;
+}
 
-    for(;;){
-        while(((*adctl) & 0x80) == 0x00);
-        delay = (*adr1 * 9);
+char *labelPut(char *out, unsigned int address, int plain)
+/* Purpose: Writes the symbol at address, or its dis label (L and the address) if it is a branch target in
+            the listing being made. Otherwise writes $ and the address if plain is set, or nothing.
+            Returns the end of the text, without a '\0'.
+Functions used: textPut(), hexPutWord()
+Version: 1.0
+*/{
+    int i;
 
-        *portA = sequence[counter];
+    for(i = 0; i < symbolCount; i++){
+        if (symbols[i].address == address){
+            return textPut(out, symbols[i].name);
+        }
+    }
+    for(i = 0; i < disLabelCount; i++){
+        if (disLabels[i] == address){
+            return hexPutWord(textPut(out, "L"), address);
+        }
+    }
+    return plain ? hexPutWord(textPut(out, "$"), address) : out;
+}
 
-        //Alter direction of motor
-        counter += (delay > POT_MIDPOINT) ? 1 : -1;
+void dumpRow(char *row, unsigned char *pointer, int count, int width)
+/* Purpose: Used by dm
+            Builds one display memory row, address, width bytes in hex (count of them filled in) and as ASCII.
+Functions used: hexPut(), hexPutWord(), textPut()
+Version: 1.1
+*/{
+    int i;
 
-        if(counter > 8){
-            counter = 0;
-        } else if(counter < 0){
-            counter = 8;
+    row = hexPutWord(textPut(row, "\n "), ADDR(pointer));
+    row = textPut(row, "    ");
+    for(i = 0; i < width; i++){
+        if (i < count){
+            row = hexPut(row, pointer[i]);
+        }else{
+            *row++ = ' ';
+            *row++ = ' ';
         }
-        //flatten curve at bottom
-        delay = delay >= 800 && delay <= 1200 ? 1000 : delay;
-        //Map value onto a curve, scales the inputs to more reasonable values.
-        //The curve allows the speed control for the forward/reverse options
-        delay = ((delay - POT_MIDPOINT) * (delay - POT_MIDPOINT)) / 15000;
+        *row++ = ' ';
+    }
+    row = textPut(row, "    ");
+    for(i = 0; i < count; i++){
+        *row++ = (pointer[i] > 127 || pointer[i] < 32) ? '.' : pointer[i];
+    }
+    *row = '\0';
+}
 
-        for(timer = 0; timer < delay; timer++);
+void disRow(char *row, unsigned char *pointer, int length, int line, char *instruction)
+/* Purpose: Used by dis
+            Builds one disassembly row, address, the instruction bytes in hex, line number and the instruction.
+Functions used: hexPut(), hexPutWord(), decPut(), textPut()
+Version: 1.0
+*/{
+    int i;
 
+    row = hexPutWord(textPut(row, "\n "), ADDR(pointer));
+    row = textPut(row, "  ");
+    for(i = 0; i < 5; i++){
+        if (i < length){
+            row = hexPut(row, pointer[i]);
+        }else{
+            *row++ = ' ';
+            *row++ = ' ';
+        }
+        *row++ = ' ';
     }
+    row = textPut(decPut(row, line, 3), "    ");
+    row = textPut(row, instruction);
+    *row = '\0';
 }
 
 // ################# Helper Functions ######################
 
-int strToHex(char *start, int bytes)
-/* Author Haydn Gynn
-Company: Staffordshire University
-Created: 04/12/2020
-Purpose: A specialised lightweight function used when loading a file.
-        Converts an ascii string into a validated hex value.
-        Supports multiple byte hex values.
-        Provide a start address, and how many bytes the Hex number is expected to have
+int putchar(int c)
+/* Purpose: Replaces the library putchar, so printf() output also goes through the transmit buffer.
+Functions used: mputchar()
 Version: 1.0
-*/
-{
-    int total = -1, value;
-    char *p;
+*/{
+    return mputchar(c);
+}
 
-    for (p = start;start <= p + ((bytes*2)-1); start++) {
-        value = *start;
-        if(value >= 'A' && value <= 'F'){
-            value = value - 55;
-        }else if(value >= '0' && value <= '9'){
-            value = value - 48;
-        } else{
-            return -1;
+int mputchar(int c)
+/* Purpose: Custom putchar function.
+            Queues the character in the transmit ring buffer and enables the transmit interrupt,
+            only waiting if the buffer is full. If the buffer stays full for TX_TIMEOUT the transmitter
+            is taken to be stalled (e.g. interrupts masked by a user program) and characters are dropped
+            and counted, rather than hanging the monitor, until the interrupt sends something again.
+Version: 1.0
+*/{
+    unsigned char next = (txHead + 1) & (TX_SIZE - 1), used;
+    unsigned int wait = 0;
+
+    while(next == txTail){
+        if (txStalled || ++wait >= TX_TIMEOUT){
+            txStalled = 1;
+            txDropped++;
+            return c;
         }
-        if(total != -1){
-            total = (total << 4) + value;
-        } else{
-            total = value;
+        IDLE();
+    }
+
+    txBuffer[txHead] = c;
+    txHead = next;
+    used = (txHead - txTail) & (TX_SIZE - 1);
+    if (used > txHighWater){
+        txHighWater = used;
+    }
+    REG_WRITE(R_SCCR2, REG_READ(R_SCCR2) | 0x80);   /*TIE*/
+
+    return c;
+}
+
+void mputs(const char *text)
+/* Purpose: Sends a string as it is, for rows already formatted without printf().
+            Copies as much as fits straight into the transmit buffer and enables the transmit interrupt once,
+            only falling back to mputchar() (which waits) when the buffer is full.
+Functions used: mputchar()
+Version: 1.1
+*/{
+    unsigned char head = txHead, next, used;
+
+    while(*text){
+        next = (head + 1) & (TX_SIZE - 1);
+        if (next == txTail){
+            txHead = head;
+            REG_WRITE(R_SCCR2, REG_READ(R_SCCR2) | 0x80);   /*TIE, send what is queued*/
+            mputchar(*text++);
+            head = txHead;
+            continue;
         }
+        txBuffer[head] = *text++;
+        head = next;
     }
-    return total;
+    txHead = head;
+
+    used = (txHead - txTail) & (TX_SIZE - 1);
+    if (used > txHighWater){
+        txHighWater = used;
+    }
+    REG_WRITE(R_SCCR2, REG_READ(R_SCCR2) | 0x80);   /*TIE*/
+}
+
+void mflush()
+/* Purpose: Waits until everything queued by mputchar() has been sent and the transmitter is idle (SCSR TC).
+Version: 1.0
+*/{
+    while(txHead != txTail && !txStalled){
+        IDLE();
+    }
+    while((REG_READ(R_SCSR) & 0x40) == 0);      /*TC*/
 }
 
-int validateHexArgs(Command *command, char* input, unsigned char** args, int partsCount)
+int validateHexArgs(const Command *command, Token *tokens, int partsCount, Arg *args)
 /* Author Haydn Gynn
 Company: Staffordshire University
 Created: 04/12/2020
-Functions used: sscanf(), printf()
-Purpose: a universal function for parsing the hex command parameters,
+Modified: 17/10/2026
+Functions used: printf(), strlen()
+Purpose: a universal function for checking the hex command parameters,
         Expects memory from the args pointer to already be allocated with enough room to store all the params.
-        Validates input is correct Hex digits, and ensures its within the correct range.
-Version: 1.0
+        Checks the arguments tokenize() found are hex, and ensures they are within the correct range.
+        command->params has a letter for each argument, A an address, N a number (in value, not pointer),
+        P a pattern of hex bytes (a pointer to its text), lower case if the argument is optional.
+        given is cleared for optional arguments that are left out, handlers check it rather than NULL,
+        which is address 0 on the board. An address after the first can also be given as +count,
+        the address count bytes on from the previous one.
+Version: 3.2
 */{
-    int i, bytes = 0;
+    int i, required = 0, type;
+    unsigned int value;
+    Token *token;
 
-    if (partsCount == 1 && command->params == 0){
-        return 1;
+    for(i = 0; command->params[i] >= 'A' && command->params[i] <= 'Z'; i++){
+        required++;
     }
 
-    if (partsCount > command->params + 1){
+    if (partsCount - 1 > (int)strlen(command->params)){
         printf("\nToo many arguments specified, Usage: %s\n", command->usage);
         printf("\nContinuing command execution\n");
-        if (command->params == 0){
-            return 1;
-        }
     } // Continue command execution after warning
 
-    if (partsCount <= command->params){
+    if (partsCount - 1 < required){
         printf("\nIncorrect usage. Please use %s", command->usage);
         return 0; // Stop command execution, ensure correct usage.
     }
 
-    //Max 3 number of reads currently, can increase if needed
+    for(i = 0; command->params[i]; i++){
+        args[i].pointer = NULL;
+        args[i].value = 0;
+        args[i].given = 0;
+        if (i + 1 >= partsCount){
+            continue;   // Optional and not given
+        }
+        token = &tokens[i + 1];
+        args[i].given = 1;
 
+        type = command->params[i] | 0x20;    // Lower case
+        if (type == 'p'){
+            if (token->relative || token->digits == 0 || token->digits % 2 || token->digits > PATTERN_SIZE * 2){
+                printf("\nThe pattern must be 1 to %d bytes in hex i.e 0A0D", PATTERN_SIZE);
+                return 0;
+            }
+            args[i].pointer = (unsigned char *)token->text;
+            continue;
+        }
 
-    for(i = 0; i < command->params; i++){
-        if (sscanf(input, "%x%n", args + i, &bytes) != 2){
+        if (token->digits == 0 || token->digits > 4 || (token->relative && (type != 'a' || i == 0 || !args[i - 1].given))){
             printf("\nAddress must be in hex i.e 0-9 A-F");
             return 0;
         }
-        input += bytes;
+        value = token->value;
 
-        if (*(args + i) < MIN || *(args + i) > MAX){
+        if (type == 'n'){
+            args[i].value = value;
+            continue;
+        }
+        if (token->relative){
+            if (value == 0 || value - 1 > ADDR(MAX) - ADDR(args[i - 1].pointer)){
+                printf("\nThe address range is 400 -> 7DFF");
+                return 0;
+            }
+            value += ADDR(args[i - 1].pointer) - 1;
+        }
+        args[i].pointer = PTR(value);
+
+        if (args[i].pointer < MIN || args[i].pointer > MAX){
             printf("\nThe address range is 400 -> 7DFF");
             return 0;
         }
     }
-
     return 1;
 }
 
@@ -732,37 +2929,41 @@ char *mgets(char *pointer, int maxlength, int instantMode)
 Company: Staffordshire University
 Created: 27/02/2019
 Modified: 28/11/2020
+Modified: 17/10/2026
 Functions used: mgetchar()
 Purpose: Custom gets function, only captures string for the specified length.
 		Enables backspace to work.
 		Prevents exceeding stated length.
 		Function modified to fit current purpose.
 		Contains 'instantMode', this means it will not wait for \n  even after the limit is reached.
-Version: 2.0
+		Nothing is echoed in batch mode.
+Version: 2.1
 */
 {
     char *string = pointer;
-    int Input, length = 0;
+    int Input, length = 0, echo = !batchMode;
 
     while(1){
         if ((Input = mgetchar()) == EOF)
             return (NULL);
         if (Input == '\n'){
-            putchar(Input);
+            if (echo) putchar(Input);
             break;
         }else if(Input == '\b'){ /*Allow backspace to work*/
             if(length <= 0) continue;
-            putchar('\b');
-            putchar(' ');
-            putchar('\b');
+            if (echo){
+                putchar('\b');
+                putchar(' ');
+                putchar('\b');
+            }
             *(--string) = ' ';
             length--;
         }else if(length < maxlength){
             *string++ = Input;
             length++;
-            putchar(Input);
+            if (echo) putchar(Input);
             if(length >= maxlength && instantMode == 1) {
-                putchar('\n');
+                if (echo) putchar('\n');
                 break;
             }
         }
@@ -779,21 +2980,17 @@ int mgetchar()
 /* Author Haydn Gynn
 Company: Staffordshire University
 Created: 27/02/2019
-Modified: 28/11/2020
+Modified: 17/10/2026
 Purpose: Custom mgetchar function.
 		Waits for input buffer.
 		If a character is received from the input buffer, it is returned as a char.
 		Modified to fit current purpose.
-Version: 2.0
+		Reads from the ring buffer filled by sciIsr() rather than polling the SCI.
+Functions used: mgetbyte()
+Version: 3.1
 */
 {
-    unsigned char *SCDR, *SCSR,data;
-
-    SCDR = (unsigned char*) 0x2F;
-    SCSR = (unsigned char*) 0x2E;
-
-    while((((*SCSR) & 0x20) == 0));
-    data = *SCDR;
+    int data = mgetbyte(0);
 
     if (data == '\r')
         data = '\n';
@@ -801,114 +2998,303 @@ Version: 2.0
     return data;
 }
 
-int trim(char *string, char * trimmedString)
-/* Author Haydn Gynn
-Company: Staffordshire University
-Created: 13/03/2019
-Modified: 28/11/2020
-Purpose: Trims the string of leading and trailing spaces and returns the number of parts separated by spaces
- (e.g. "  Hi this is a test " = 5)
+int mgetbyte(unsigned int timeout)
+/* Purpose: Returns the next received byte unchanged (for binary data), waiting at most timeout loops
+            for it to arrive, or forever if timeout is 0. Returns EOF if nothing arrived in time.
 Version: 1.0
 */{
-    char * Start = NULL,* Finish, *temp;
-    int partsCount = 0;
-    temp = string;
+    unsigned char data;
+    unsigned int wait = 0;
 
-    while(*temp != '\0'){
-        if(*temp != ' '){
-            if((*(temp+1) == ' ' || *(temp+1) == '\0')){
-                Finish = temp + 1;
-                partsCount++;
-            }
-            if (Start == NULL){
-                Start = temp;
-            }
+    while(rxHead == rxTail){
+        if (timeout && ++wait >= timeout){
+            return EOF;
         }
-        temp++;
-    }
-    if(Start == NULL) {
-        Start = string;
-        Finish = temp;
-    }
-
-    //Copy from string to trimmedString from start to finish
-    while(Start != Finish){
-        *trimmedString = (char)*(Start++);
-        trimmedString++;
+        IDLE();
     }
-    *trimmedString = '\0';
+    data = rxBuffer[rxTail];
+    rxTail = (rxTail + 1) & (RX_SIZE - 1);
 
-    return partsCount;
+    return data;
 }
 
+#ifdef CRC_NIBBLE
+// CRC-16/CCITT of each nibble, a 32 byte table for when ROM is short
+const unsigned int crcTable[16] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+};
+#else
+// CRC-16/CCITT of each byte
+const unsigned int crcTable[256] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+    0x1231, 0x0210, 0x3273, 0x2252, 0x52B5, 0x4294, 0x72F7, 0x62D6,
+    0x9339, 0x8318, 0xB37B, 0xA35A, 0xD3BD, 0xC39C, 0xF3FF, 0xE3DE,
+    0x2462, 0x3443, 0x0420, 0x1401, 0x64E6, 0x74C7, 0x44A4, 0x5485,
+    0xA56A, 0xB54B, 0x8528, 0x9509, 0xE5EE, 0xF5CF, 0xC5AC, 0xD58D,
+    0x3653, 0x2672, 0x1611, 0x0630, 0x76D7, 0x66F6, 0x5695, 0x46B4,
+    0xB75B, 0xA77A, 0x9719, 0x8738, 0xF7DF, 0xE7FE, 0xD79D, 0xC7BC,
+    0x48C4, 0x58E5, 0x6886, 0x78A7, 0x0840, 0x1861, 0x2802, 0x3823,
+    0xC9CC, 0xD9ED, 0xE98E, 0xF9AF, 0x8948, 0x9969, 0xA90A, 0xB92B,
+    0x5AF5, 0x4AD4, 0x7AB7, 0x6A96, 0x1A71, 0x0A50, 0x3A33, 0x2A12,
+    0xDBFD, 0xCBDC, 0xFBBF, 0xEB9E, 0x9B79, 0x8B58, 0xBB3B, 0xAB1A,
+    0x6CA6, 0x7C87, 0x4CE4, 0x5CC5, 0x2C22, 0x3C03, 0x0C60, 0x1C41,
+    0xEDAE, 0xFD8F, 0xCDEC, 0xDDCD, 0xAD2A, 0xBD0B, 0x8D68, 0x9D49,
+    0x7E97, 0x6EB6, 0x5ED5, 0x4EF4, 0x3E13, 0x2E32, 0x1E51, 0x0E70,
+    0xFF9F, 0xEFBE, 0xDFDD, 0xCFFC, 0xBF1B, 0xAF3A, 0x9F59, 0x8F78,
+    0x9188, 0x81A9, 0xB1CA, 0xA1EB, 0xD10C, 0xC12D, 0xF14E, 0xE16F,
+    0x1080, 0x00A1, 0x30C2, 0x20E3, 0x5004, 0x4025, 0x7046, 0x6067,
+    0x83B9, 0x9398, 0xA3FB, 0xB3DA, 0xC33D, 0xD31C, 0xE37F, 0xF35E,
+    0x02B1, 0x1290, 0x22F3, 0x32D2, 0x4235, 0x5214, 0x6277, 0x7256,
+    0xB5EA, 0xA5CB, 0x95A8, 0x8589, 0xF56E, 0xE54F, 0xD52C, 0xC50D,
+    0x34E2, 0x24C3, 0x14A0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
+    0xA7DB, 0xB7FA, 0x8799, 0x97B8, 0xE75F, 0xF77E, 0xC71D, 0xD73C,
+    0x26D3, 0x36F2, 0x0691, 0x16B0, 0x6657, 0x7676, 0x4615, 0x5634,
+    0xD94C, 0xC96D, 0xF90E, 0xE92F, 0x99C8, 0x89E9, 0xB98A, 0xA9AB,
+    0x5844, 0x4865, 0x7806, 0x6827, 0x18C0, 0x08E1, 0x3882, 0x28A3,
+    0xCB7D, 0xDB5C, 0xEB3F, 0xFB1E, 0x8BF9, 0x9BD8, 0xABBB, 0xBB9A,
+    0x4A75, 0x5A54, 0x6A37, 0x7A16, 0x0AF1, 0x1AD0, 0x2AB3, 0x3A92,
+    0xFD2E, 0xED0F, 0xDD6C, 0xCD4D, 0xBDAA, 0xAD8B, 0x9DE8, 0x8DC9,
+    0x7C26, 0x6C07, 0x5C64, 0x4C45, 0x3CA2, 0x2C83, 0x1CE0, 0x0CC1,
+    0xEF1F, 0xFF3E, 0xCF5D, 0xDF7C, 0xAF9B, 0xBFBA, 0x8FD9, 0x9FF8,
+    0x6E17, 0x7E36, 0x4E55, 0x5E74, 0x2E93, 0x3EB2, 0x0ED1, 0x1EF0
+};
+#endif
+
+int rp()
+/* Purpose: Binary remote protocol for programs driving the monitor (host/rpclient.c), instead of reading dm and typing mm.
+            Requests are SOH, opcode, address (high, low), length, payload, CRC16 (high, low), with the CRC over
+            everything after SOH as in lb. Only RP_WRITE has a payload. The answer is a frame the same shape with the
+            same opcode (RP_READ and RP_REGS carry data, RP_REGS at the frame's address), NAK if the request was corrupt or stopped part way so the
+            host can send it again, or CAN if it was refused (an unknown opcode, a read of the register block,
+            a write the memory map does not allow, or a call outside MIN -> MAX).
+            A write's payload is staged (in lf's first record buffer) and only copied into memory once the CRC is
+            good, so a corrupt frame writes nothing and sending one again is harmless. A NAK is sent to start,
+            as lb does, and RP_QUIT goes back to the text commands.
+Functions used: printf(), putchar(), mgetbyte(), mflush(), crc16(), rpReply(), memoryAllows(), memoryReadable()
+Version: 1.2
+*/{
+    int c, i, length, write;
+    unsigned int crc;
+    unsigned char header[4], *stage = srecBuffers[0].data, *pointer;
 
-int splitArgs(char* command, char **args)
-/* Author Haydn Gynn
-Company: Staffordshire University
-Created: 04/12/2020
-Purpose: Splits up the given command into 'command' and 'args'.
-            '\0' is used to signify the end of the command.
-            Requires input to already be trimmed.
-Example: Input(command = "dis 500 600") Output(command = "dis", args="500 600")
-Version: 2.0
-*/
-{
-    int pointer = 0, commandEnd = 0;
+    printf("\n%*cRemote protocol\n", 10, ' ');
+    mflush();
+    putchar(NAK);
 
-    while(command[pointer] != '\0') {
-        if (command[pointer] == ' '){
-            commandEnd = pointer;
-            break;
+    while(1){
+        if (mgetbyte(0) != SOH){
+            continue;   // Resynchronise on the next frame
+        }
+
+        //Header, then the payload of a write and the CRC
+        crc = 0xFFFF;
+        for(i = 0; i < 4; i++){
+            if ((c = mgetbyte(RX_TIMEOUT)) == EOF){
+                break;
+            }
+            crc = crc16(crc, c);
+            header[i] = c;
+        }
+        if (c == EOF){
+            putchar(NAK);
+            continue;
+        }
+        pointer = PTR((header[1] << 8) | header[2]);
+        length = header[3];
+        write = header[0] == RP_WRITE ? length : 0;
+        for(i = 0; i < write + 2; i++){
+            if ((c = mgetbyte(RX_TIMEOUT)) == EOF){
+                break;
+            }
+            if (i < write){
+                stage[i] = c;
+            }
+            crc = crc16(crc, c);
+        }
+        if (c == EOF || crc != 0){
+            putchar(NAK);
+            continue;
         }
-        pointer++;
-    }
 
-    if (command[pointer] == '\0'){
-        return 0; // Command has no arguments
+        switch (header[0]) {
+            case RP_READ:
+                if (length && (length - 1 > 0xFFFF - ADDR(pointer) || !memoryReadable(pointer, pointer + length - 1))){
+                    putchar(CAN);
+                    break;
+                }
+                rpReply(header, pointer, length);
+                break;
+            case RP_WRITE:
+                if (!memoryAllows(pointer, pointer + (length ? length - 1 : 0), MEM_WRITE)){
+                    putchar(CAN);
+                    break;
+                }
+                for(i = 0; i < length; i++){
+                    pointer[i] = stage[i];
+                }
+                rpReply(header, pointer, 0);
+                break;
+            case RP_CALL:
+                if (pointer < MIN || pointer > MAX){
+                    putchar(CAN);
+                    break;
+                }
+                mflush();
+                CALL(pointer);
+                ENABLE_INTERRUPTS();
+                rpReply(header, pointer, 0);
+                break;
+            case RP_REGS:
+                if (breakFrame != NULL){
+                    header[1] = ADDR(breakFrame) >> 8;      // The frame's address gives the program's SP
+                    header[2] = ADDR(breakFrame) & 0xFF;
+                }
+                rpReply(header, breakFrame, breakFrame == NULL ? 0 : FRAME_SIZE);
+                break;
+            case RP_QUIT:
+                rpReply(header, pointer, 0);
+                return 1;
+            default:
+                putchar(CAN);
+        }
     }
-    command[commandEnd] = '\0';
+}
 
-    *args = &command[commandEnd + 1];
+void rpReply(unsigned char *header, unsigned char *data, int length)
+/* Purpose: Used by rp, answers a request with its header (length changed to the bytes of data sent) and length bytes of data.
+Functions used: putchar(), crc16()
+Version: 1.0
+*/{
+    unsigned int crc = 0xFFFF;
+    int i;
 
-    return 1;
+    header[3] = length;
+    putchar(SOH);
+    for(i = 0; i < 4; i++){
+        putchar(header[i]);
+        crc = crc16(crc, header[i]);
+    }
+    for(i = 0; i < length; i++){
+        putchar(data[i]);
+        crc = crc16(crc, data[i]);
+    }
+    putchar(crc >> 8);
+    putchar(crc & 0xFF);
 }
 
-int clearString(char *string, int length)
-/* Author Haydn Gynn
-Company: Staffordshire University
-Date: 27/02/2019
-Functions used: None
-Purpose: Pre-pads out the string to remove unwanted data and to set to spaces.
+int unpack(unsigned char *out, unsigned char *data, int length)
+/* Purpose: Used by lb, expands the packed data of a frame that has passed its CRC to out,
+            or only works out how many bytes it unpacks to when out is NULL, so lb can check where they go first.
+            The data is a run of tokens, a byte 00-7F then that many + 1 literal bytes, or a byte 80-FF
+            for a copy of (its low 7 bits + 3) bytes from a distance of the next byte + 1 back.
+            The copy comes from what the frame has already unpacked, so the 256 byte window needs no
+            buffer, and a distance of 1 repeats a byte (runs of zeros).
+            Returns the bytes unpacked, or -1 if a token is cut short or copies from before the start of the frame.
 Version: 1.0
-*/
-{
-    int i;
+*/{
+    unsigned char *from;
+    int i = 0, size = 0, count, distance;
 
-    for(i = 0;i<length-1;i++){
-        string[i] = ' ';
+    while(i < length){
+        if (data[i] & 0x80){
+            if (i + 1 >= length){
+                return -1;
+            }
+            count = (data[i] & 0x7F) + 3;
+            distance = data[i + 1] + 1;
+            if (distance > size){
+                return -1;
+            }
+            if (out != NULL){
+                for(from = out + size - distance; count; count--, size++){
+                    out[size] = *from++;    // A byte at a time, the copy may overlap what it writes
+                }
+            }else{
+                size += count;
+            }
+            i += 2;
+        }else{
+            count = data[i++] + 1;
+            if (i + count > length){
+                return -1;
+            }
+            if (out != NULL){
+                for(; count; count--){
+                    out[size++] = data[i++];
+                }
+            }else{
+                size += count;
+                i += count;
+            }
+        }
     }
-    string[length-1] = '\0';
+    return size;
+}
 
-    return 1;
+unsigned int crc16(unsigned int crc, unsigned char data)
+/* Purpose: Adds a byte to a CRC-16/CCITT (polynomial 0x1021, MSB first, start with 0xFFFF).
+            One table lookup per byte, or two with CRC_NIBBLE defined, instead of a shift per bit.
+Version: 2.0
+*/{
+#ifdef CRC_NIBBLE
+    crc = (crc << 4) ^ crcTable[((crc >> 12) ^ (data >> 4)) & 0x0F];
+    crc = (crc << 4) ^ crcTable[((crc >> 12) ^ data) & 0x0F];
+#else
+    crc = (crc << 8) ^ crcTable[((crc >> 8) ^ data) & 0xFF];
+#endif
+    return crc & 0xFFFF;
 }
 
-int strToLower(char *pointer)
-/* Author Haydn Gynn
-Company: Staffordshire University
-Created: 04/12/2020
-Purpose: Makes all characters in a string lowercase
-Example: Input(HELLO) Output(hello)
+int tokenize(char *line, Token *tokens)
+/* Purpose: Splits the line into words in place, in one pass, and returns how many there are.
+            Spaces after each word are replaced with '\0'. The first word (the command) is made lower case,
+            the hex value and digit count of each later word are worked out as it is read.
+            Only the first MAX_TOKENS words are kept, but all of them are counted.
+Example: Input("DM 400 +20") Output(3 tokens: "dm", "400" = 0x400, "+20" = 0x20 relative)
 Version: 1.0
-*/
-{
-    int counter = 0;
+*/{
+    int count = 0, digit, hex = 0;
+    Token *token = NULL;
+
+    for(; *line != '\0'; line++){
+        if (*line == ' '){
+            *line = '\0';
+            token = NULL;
+            continue;
+        }
 
-    for(; *pointer != '\0'; pointer++){
-        if (counter == 100) return 0; // Make sure loop doesnt run forever if no \0 found
+        if (token == NULL){
+            token = count < MAX_TOKENS ? &tokens[count] : NULL;
+            count++;
+            if (token == NULL){
+                for(; line[1] != ' ' && line[1] != '\0'; line++);
+                continue;   // Too many words, only counted
+            }
+            token->text = line;
+            token->value = 0;
+            token->digits = 0;
+            token->relative = (*line == '+' && count > 1);
+            hex = 1;
+            if (token->relative){
+                continue;
+            }
+        }
 
-        *pointer = tolower(*pointer);
-        counter++;
+        if (count == 1){
+            if (*line >= 'A' && *line <= 'Z'){
+                *line |= 0x20;
+            }
+        }else if (hex){
+            if ((digit = hexValues[(unsigned char)*line]) < 0){
+                token->digits = hex = 0;    // Not hex
+            }else{
+                token->value = (token->value << 4) | digit;
+                token->digits++;
+            }
+        }
     }
 
-    return 1;
-}
\ No newline at end of file
+    return count;
+}
@@ -0,0 +1,33 @@
+#ifndef MONITOR_H
+#define MONITOR_H
+
+/*Purpose: The monitor's command table and the main.c routines other programs call, shared by main.c and the
+            host tools built against it (host/monbench.c), so both sides see the same types.
+*/
+
+#define MAX_ARGS 3
+
+// One argument of a command, filled in by validateHexArgs()
+typedef struct{
+    unsigned char *pointer;     // Address, or the text of a pattern
+    unsigned int value;         // Number (N), never a pointer so 0 is not NULL
+    unsigned char given;        // 0 if the argument is optional and was left out
+}Arg;
+
+// Commands are looked up by binary search (see findCommand()), so the table must stay in key order
+typedef struct command{
+    const char *key;
+    const char *usage;
+    const char *description;
+    int (*handler)(const struct command*, int, Arg*);
+    char params[MAX_ARGS + 1];  // One letter per hex argument: A/a address, N/n number, P byte pattern (lower case optional)
+}Command;
+
+extern const Command commands[];
+
+int handleCommand(const Command*, char*);
+int lf(), dis(unsigned char *start, unsigned char *end), dm(unsigned char *start, unsigned char *end, int width);
+int decodeInstruction(unsigned char *, char *);
+void sciInit(), timerInit(), mflush();
+
+#endif
@@ -1,51 +1,85 @@
-/* SG90 Servo driver cycle -90 degree to +90 degree */
+/*Purpose: SG90 servo driver for up to four servos on OC2-OC5 (Port A6-A3), built with cram2.BAT servo.c,
+            loaded with lf and started with go. go returns straight to the monitor and the servos are then
+            driven in the background, change their angles with the monitor's servo command.
+            The pulses are made by the timer hardware: OC1 sets every enabled pin at the start of each 20ms
+            period and OC2-OC5 clear their own pin when the pulse is long enough, so the width does not
+            depend on interrupt latency. servoIsr() runs once a period on OC1 to set up the next one.
+            The angles are kept in a ServoBlock at SERVO_BLOCK where the monitor can find them.
+            The Makefile also builds it with -DHOST into hc11sim, where -S starts it before the monitor.
+*/
+
+#include "hal.h"
+
+#define PV_TOC1 0x00DF              // Pseudo vector for the OC1 interrupt
+#define SERVO_BLOCK 0x7980          // ServoBlock, between the top of the lf area and the stack, must match main.c
+#define SERVO_MAGIC 0x5A            // In ServoBlock.magic while the driver is running
+#define SERVO_CHANNELS 4            // OC2-OC5
+#define SERVO_OFF 0xFF              // Angle for no pulses on a channel
+#define SERVO_PERIOD 40000          // 20ms in E-clock cycles
+#define SERVO_MIN 2000              // 1ms pulse, 0 degrees (-90)
+#define SERVO_MAX 4000              // 2ms pulse, 180 degrees (+90)
+
+// Pulse width in E-clock cycles for each whole degree, worked out by the compiler
+#define T1(d) (SERVO_MIN + (unsigned int)((unsigned long)(d) * (SERVO_MAX - SERVO_MIN) / 180))
+#define T10(d) T1(d), T1(d + 1), T1(d + 2), T1(d + 3), T1(d + 4), T1(d + 5), T1(d + 6), T1(d + 7), T1(d + 8), T1(d + 9)
+
+const unsigned int servoTicks[181] = {
+    T10(0), T10(10), T10(20), T10(30), T10(40), T10(50), T10(60), T10(70), T10(80),
+    T10(90), T10(100), T10(110), T10(120), T10(130), T10(140), T10(150), T10(160), T10(170), T1(180)
+};
+
+typedef struct{
+    unsigned char magic;                    // SERVO_MAGIC while servoIsr() is installed
+    unsigned char angle[SERVO_CHANNELS];    // Degrees 0-180 for OC2-OC5, SERVO_OFF for none
+}ServoBlock;
+
+INTERRUPT void servoIsr(void)
+/* Purpose: OC1 interrupt at the start of each period, the pins have just been set by OC1.
+            Sets each enabled channel's compare to end its pulse, the OC1M mask for the next period
+            and the next OC1 compare, all from the compare just passed so the period never drifts.
+Version: 1.0
+*/{
+    ServoBlock *block = (ServoBlock *)PTR(SERVO_BLOCK);
+    unsigned int start = REG_READ16(R_TOC1);
+    unsigned char i, mask = 0;
+
+    REG_WRITE(R_TFLG1, 0x80);                       /*Clear OC1F*/
+    for(i = 0; i < SERVO_CHANNELS; i++){
+        if (block->angle[i] <= 180){
+            REG_WRITE16(R_TOC2 + i * 2, start + servoTicks[block->angle[i]]);  /*TOC2-TOC5*/
+            mask |= 0x40 >> i;
+        }
+    }
+    REG_WRITE(R_OC1M, mask);                        /*Pins OC1 sets next period*/
+    REG_WRITE16(R_TOC1, start + SERVO_PERIOD);
+}
+
+void servoInit(void)
+/* Purpose: Centres every channel, sets OC2-OC5 to clear their pins and OC1 to set them,
+            then installs servoIsr() and starts the first period.
+Version: 1.0
+*/{
+    ServoBlock *block = (ServoBlock *)PTR(SERVO_BLOCK);
+    unsigned char i;
+
+    REG_WRITE(R_TMSK1, REG_READ(R_TMSK1) & ~0x80);  /*OC1I off while setting up*/
+    for(i = 0; i < SERVO_CHANNELS; i++){
+        block->angle[i] = 90;
+    }
+
+    REG_WRITE(R_TCTL1, 0xAA);                       /*OC2-OC5 clear their pin on compare*/
+    REG_WRITE(R_OC1D, 0x78);                        /*OC1 sets PA6-PA3*/
+    REG_WRITE(R_OC1M, 0x00);                        /*No pulse until servoIsr() has set the widths*/
+
+    SET_VECTOR(PV_TOC1, servoIsr);
+    block->magic = SERVO_MAGIC;
+
+    REG_WRITE16(R_TOC1, REG_READ16(R_TCNT) + SERVO_PERIOD);
+    REG_WRITE(R_TFLG1, 0x80);                       /*Clear OC1F*/
+    REG_WRITE(R_TMSK1, REG_READ(R_TMSK1) | 0x80);   /*OC1I*/
+}
+
 void main(void)
 {
-unsigned int *tcnt,*toc2,delay1, delay2,dwait;
-unsigned char *tflg1,*tctl1,*pgddr,*pgdr;
-tctl1=(unsigned char*)0x20;
-tflg1=(unsigned char*)0x23;
-toc2=(unsigned int*)0x18;
-tcnt=(unsigned int*)0x0e;
-pgddr=(unsigned char*)0x3;
-pgdr=(unsigned char*)0x02;
-/* Define Port G as all outputs */
-*pgddr =0xff;
-/* Allow Port A not be used by timer */
-*tctl1=0x00;
-/* Repeat forever */
-for(;;)
-{
-/* Need to physical send a PWM for a fixed time */
-	for (dwait = 0;dwait <= 0xf;dwait++)
-	{
-	/* Move forward + 90 degrees*/
-	delay1 = 0x8ac0;  /* off (Space) time */
-	delay2 = 0x0fa0;  /* on (Mark) time */
-	*pgdr = 0x00; /* Turn PWM signal off */
-	*tflg1=0x40; /*Clear TOC2 Flag*/
-	*toc2=*tcnt+delay1; /*Read timer and add offset period*/
-	while(((*tflg1)&0x40)==0); /*Wait for TOC2 FLAG */
-	*pgdr = 0x1; /* Turn PWM signal on */
-	*tflg1=0x40; /*Clear TOC2 Flag*/
-	*toc2=*tcnt+delay2; /*Read timer and add offset period */
-	while(((*tflg1)&0x40)==0); /*Wait for TOC2 FLAG */
-	}
-
-/* Need to physical send a PWM for a fixed time */
-	for (dwait = 0;dwait <= 0xf;dwait++)
-	{
-	/* Move back  -90 degrees*/
-	delay1 = 0x9470;  /* off (Space) time */
-	delay2 = 0x07d0;  /* on (Mark) time */
-	*pgdr = 0x00; /* Turn PWM signal off */
-	*tflg1=0x40; /*Clear TOC2 Flag*/
-	*toc2=*tcnt+delay1; /*Read timer and add offset period*/
-	while(((*tflg1)&0x40)==0); /*Wait for TOC2 FLAG */
-	*pgdr = 0x1; /* Turn PWM signal on */
-	*tflg1=0x40; /*Clear TOC2 Flag*/
-	*toc2=*tcnt+delay2; /*Read timer and add offset period */
-	while(((*tflg1)&0x40)==0); /*Wait for TOC2 FLAG */
-	}
-}
+    servoInit();
 }